@@ -0,0 +1,70 @@
+#include "arena.hpp"
+
+#include <cassert>
+#include <new>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace Msl {
+
+Arena::Arena()
+{
+    // mmap only promises page alignment, map one arena more and trim the
+    // unaligned ends.
+    void* mapping = mmap(nullptr, 2 * Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+    char* start = static_cast<char*>(mapping);
+    m_base = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(start) + Size - 1) & ~(Size - 1));
+    if (m_base != start) {
+        munmap(start, m_base - start);
+    }
+    munmap(m_base + Size, start + Size - m_base);
+#ifdef MADV_HUGEPAGE
+    // Only a hint, the arena works the same on small pages.
+    madvise(m_base, Size, MADV_HUGEPAGE);
+#endif
+}
+
+Arena::~Arena()
+{
+    munmap(m_base, Size);
+}
+
+void* Arena::takeBlock()
+{
+    if (full()) {
+        return nullptr;
+    }
+    unsigned index = __builtin_ctzll(m_freeBlocks);
+    m_freeBlocks &= m_freeBlocks - 1;
+    return m_base + index * Block::Size;
+}
+
+void Arena::releaseBlock(void* block)
+{
+    assert(base(block) == base());
+    size_t index = (static_cast<char*>(block) - m_base) / Block::Size;
+    assert(!(m_freeBlocks & (uint64_t(1) << index)));
+    madvise(block, Block::Size, MADV_DONTNEED);
+    m_freeBlocks |= uint64_t(1) << index;
+}
+
+size_t Arena::residentBytes() const
+{
+    static const size_t pageSize = sysconf(_SC_PAGESIZE);
+    std::vector<unsigned char> pages(Size / pageSize);
+    if (mincore(m_base, Size, pages.data())) {
+        return 0;
+    }
+    size_t resident = 0;
+    for (auto page : pages) {
+        resident += page & 1;
+    }
+    return resident * pageSize;
+}
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "block.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Msl {
+
+// A large anonymous mapping that blocks are carved out of. Arenas are
+// aligned to their size and asked to be backed by transparent huge pages, so
+// marking a heap of many blocks touches few TLB entries. A block handed back
+// is returned to the OS, the arena keeps its address range.
+class Arena {
+public:
+    static constexpr size_t Size = 2 * 1024 * 1024;
+    static constexpr size_t BlockCount = Size / Block::Size;
+
+    static_assert(BlockCount <= 64, "Free blocks are kept in a single word");
+
+    // Maps a new arena, throws std::bad_alloc when the OS refuses.
+    Arena();
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    static uintptr_t base(const void* block)
+    {
+        return reinterpret_cast<uintptr_t>(block) & ~(Size - 1);
+    }
+
+    uintptr_t base() const { return reinterpret_cast<uintptr_t>(m_base); }
+    bool full() const { return !m_freeBlocks; }
+    bool empty() const { return m_freeBlocks == AllBlocks; }
+
+    // Returns Block::Size bytes of memory, null when the arena is full.
+    void* takeBlock();
+    // Gives the block's pages back to the OS, they read as zero if the
+    // block is taken again.
+    void releaseBlock(void* block);
+    // Bytes of the arena backed by physical memory.
+    size_t residentBytes() const;
+
+private:
+    static constexpr uint64_t AllBlocks = BlockCount == 64 ? ~uint64_t(0) : (uint64_t(1) << BlockCount) - 1;
+
+    char* m_base;
+    uint64_t m_freeBlocks { AllBlocks };
+};
+
+}
@@ -6,12 +6,13 @@
 namespace Msl {
 
 Array::Array()
+    : Object(nullptr)
 {
 }
 
 Value Array::at(size_t i)
 {
-    if (i > m_elements.size()) {
+    if (i >= m_elements.size()) {
         throw RuntimeException("Out of range index");
     }
 
@@ -20,10 +21,10 @@ Value Array::at(size_t i)
 
 Value Array::at(size_t i, Value value)
 {
-    if (i > m_elements.size()) {
+    if (i >= m_elements.size()) {
         throw RuntimeException("Out of range index");
     }
-    m_elements[i] = value;
+    write(m_elements[i], value);
     return value;
 }
 
@@ -32,8 +33,31 @@ size_t Array::size() const
     return m_elements.size();
 }
 
-std::vector<Value>& Array::elements()
+void Array::append(Value value)
 {
-    return m_elements;
+    Cell::append(m_elements, value);
+}
+
+void Array::trace(Visitor& visitor)
+{
+    Object::trace(visitor);
+    for (auto& element : m_elements) {
+        visitor.visit(element);
+    }
+}
+
+size_t Array::cellSize() const
+{
+    return sizeof(Array);
+}
+
+size_t Array::payloadSize() const
+{
+    return Object::payloadSize() + m_elements.capacity() * sizeof(Value);
+}
+
+CellType Array::cellType() const
+{
+    return CellType::Array;
 }
 }
@@ -13,7 +13,11 @@ public:
     Value at(size_t i);
     Value at(size_t i, Value value);
     size_t size() const;
-    std::vector<Value>& elements();
+    void append(Value value);
+    virtual void trace(Visitor& visitor) override;
+    virtual size_t cellSize() const override;
+    virtual size_t payloadSize() const override;
+    virtual CellType cellType() const override;
 
 private:
     std::vector<Value> m_elements;
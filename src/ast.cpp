@@ -1,332 +1,259 @@
 #include "ast.hpp"
 
-#include "array.hpp"
+#include "compiler.hpp"
 #include "exceptions.hpp"
-#include "function.hpp"
-#include "interpreter.hpp"
+#include "flatast.hpp"
+#include "resolver.hpp"
+#include "shape.hpp"
+#include "string.hpp"
 
 #include <cassert>
-#include <cmath>
-#include <iostream>
 
 namespace Msl {
 
-void printIndentation(uint32_t indentLevel)
+Scope::Scope(AstList<Statement*> body)
+    : m_body(body)
 {
-    for (size_t i = 0; i < indentLevel; ++i) {
-        std::cout << "  ";
-    }
 }
 
-Ast::Ast() { }
-Ast::~Ast() { }
-bool Ast::isIdentifier() const
+size_t Scope::slotCount() const
 {
-    return false;
+    return m_slotCount;
 }
 
-bool Ast::isMemberExpression() const
+void Scope::slotCount(size_t count)
 {
-    return false;
+    m_slotCount = count;
 }
 
-bool Ast::isArrayMemberExpression() const
+Program::Program(AstList<Statement*> body, std::unique_ptr<AstArena> arena)
+    : Ast(Kind::Program)
+    , Scope(body)
+    , m_arena(std::move(arena))
 {
-    return false;
 }
 
-Scope::Scope(std::vector<Statement*> body)
-    : m_body(body)
+BlockStatement::BlockStatement(AstList<Statement*> body)
+    : Statement(Kind::BlockStatement)
+    , Scope(body)
 {
 }
 
-Scope::~Scope()
+ExpressionStatement::ExpressionStatement(Expression* expression)
+    : Statement(Kind::ExpressionStatement)
+    , m_expression(expression)
 {
-    for (auto& statement : m_body) {
-        delete statement;
-    }
 }
 
-void Scope::append(Statement* statement)
+Literal::Literal(Value value)
+    : Expression(Kind::Literal)
+    , m_value(value)
 {
-    m_body.push_back(statement);
 }
 
-Program::Program(std::vector<Statement*> body)
-    : Scope::Scope(body)
+Literal::Literal(std::string_view string)
+    : Expression(Kind::Literal)
+    , m_isString(true)
+    , m_string(string)
 {
 }
 
-BlockStatement::BlockStatement(std::vector<Statement*> body)
-    : Scope::Scope(body)
+BinaryExpression::BinaryExpression(Operator op, Expression* left,
+    Expression* right)
+    : Expression(Kind::BinaryExpression)
+    , m_op(op)
+    , m_left(left)
+    , m_right(right)
 {
 }
 
-ExpressionStatement::ExpressionStatement(Expression* expression)
-    : m_expression(expression)
+UnaryExpression::UnaryExpression(Operator op, Expression* right)
+    : Expression(Kind::UnaryExpression)
+    , m_op(op)
+    , m_right(right)
 {
 }
 
-ExpressionStatement::~ExpressionStatement()
+Identifier::Identifier(std::string_view name)
+    : Expression(Kind::Identifier)
+    , m_name(name)
 {
-    delete m_expression;
 }
 
-Literal::Literal(Value value)
-    : m_value(value)
-{
-}
-
-BinaryExpression::BinaryExpression(Operator op, Expression* left,
-    Expression* right)
-    : m_op(op)
-    , m_left(left)
-    , m_right(right)
+std::string_view Identifier::name() const
 {
+    return m_name;
 }
 
-BinaryExpression::~BinaryExpression()
+void Identifier::bind(uint32_t depth, uint32_t slot)
 {
-    delete m_left;
-    delete m_right;
+    m_depth = depth;
+    m_slot = slot;
 }
 
-UnaryExpression::UnaryExpression(Operator op, Expression* right)
-    : m_op(op)
-    , m_right(right)
+bool Identifier::resolved() const
 {
+    return m_slot != Unresolved;
 }
 
-UnaryExpression::~UnaryExpression()
+String* Identifier::key() const
 {
-    delete m_right;
+    return m_key;
 }
 
-Identifier::Identifier(const std::string& name)
-    : m_name(name)
+void Identifier::key(String* key)
 {
+    m_key = key;
 }
 
-bool Identifier::isIdentifier() const
+uint32_t Identifier::depth() const
 {
-    return true;
+    return m_depth;
 }
 
-const std::string& Identifier::name() const
+uint32_t Identifier::slot() const
 {
-    return m_name;
+    return m_slot;
 }
 
 FunctionExpression::FunctionExpression(
-    std::vector<Identifier*> m_params,
+    AstList<Identifier*> m_params,
     BlockStatement* m_body)
-    : m_params(m_params)
+    : Expression(Kind::FunctionExpression)
+    , m_params(m_params)
     , m_body(m_body)
 {
 }
 
-FunctionExpression::~FunctionExpression()
-{
-    for (auto& param : m_params) {
-        delete param;
-    }
-    delete m_body;
-}
-
-const std::vector<Identifier*>& FunctionExpression::params() const
+const AstList<Identifier*>& FunctionExpression::params() const
 {
     return m_params;
 }
 
 ReturnStatement::ReturnStatement(Expression* argument)
-    : m_argument(argument)
-{
-}
-
-ReturnStatement::~ReturnStatement()
+    : Statement(Kind::ReturnStatement)
+    , m_argument(argument)
 {
-    delete m_argument;
 }
 
 VariableDeclarator::VariableDeclarator(Identifier* name, Expression* init)
-    : m_name(name)
+    : Ast(Kind::VariableDeclarator)
+    , m_name(name)
     , m_init(init)
 {
 }
 
-VariableDeclarator::~VariableDeclarator()
+Identifier* VariableDeclarator::name() const
 {
-    delete m_name;
-    delete m_init;
+    return m_name;
 }
 
 VariableDeclaration::VariableDeclaration(
-    std::vector<VariableDeclarator*> declarators)
-    : m_declarators(declarators)
+    AstList<VariableDeclarator*> declarators)
+    : Statement(Kind::VariableDeclaration)
+    , m_declarators(declarators)
 {
 }
 
-VariableDeclaration::~VariableDeclaration()
+const AstList<VariableDeclarator*>& VariableDeclaration::declarators() const
 {
-    for (auto& declarator : m_declarators) {
-        delete declarator;
-    }
+    return m_declarators;
 }
 
-CallExpression::CallExpression(Expression* name, std::vector<Expression*> arguments)
-    : m_name(name)
+CallExpression::CallExpression(Expression* name, AstList<Expression*> arguments)
+    : Expression(Kind::CallExpression)
+    , m_name(name)
     , m_arguments(arguments)
 {
 }
 
-CallExpression::~CallExpression()
-{
-    delete m_name;
-    for (auto& argument : m_arguments) {
-        delete argument;
-    }
-}
-
 PrintStatement::PrintStatement(Expression* argument)
-    : m_argument(argument)
-{
-}
-
-PrintStatement::~PrintStatement()
+    : Statement(Kind::PrintStatement)
+    , m_argument(argument)
 {
-    delete m_argument;
 }
 
 AssignmentExpression::AssignmentExpression(Operator op,
     Expression* left, Expression* right)
-    : m_op(op)
+    : Expression(Kind::AssignmentExpression)
+    , m_op(op)
     , m_left(left)
     , m_right(right)
 {
 }
 
-AssignmentExpression::~AssignmentExpression()
-{
-    delete m_left;
-    delete m_right;
-}
-
 LogicalExpression::LogicalExpression(Operator op,
     Expression* left, Expression* right)
-    : m_op(op)
+    : Expression(Kind::LogicalExpression)
+    , m_op(op)
     , m_left(left)
     , m_right(right)
 {
 }
 
-LogicalExpression::~LogicalExpression()
-{
-    delete m_left;
-    delete m_right;
-}
-
-void Scope::prettyPrint(int32_t indentLevel) const
-{
-    for (const auto& statement : m_body) {
-        statement->prettyPrint(indentLevel);
-    }
-}
-
 IfElseStatement::IfElseStatement(Expression* condition, Statement* ifBranch,
     Statement* elseBranch)
-    : m_condition(condition)
+    : Statement(Kind::IfElseStatement)
+    , m_condition(condition)
     , m_ifBranch(ifBranch)
     , m_elseBranch(elseBranch)
 {
 }
 IfElseStatement::IfElseStatement(Expression* condition, Statement* ifBranch)
-    : m_condition(condition)
+    : Statement(Kind::IfElseStatement)
+    , m_condition(condition)
     , m_ifBranch(ifBranch)
     , m_elseBranch(nullptr)
 {
 }
 
-IfElseStatement::~IfElseStatement()
-{
-    delete m_condition;
-    delete m_ifBranch;
-    delete m_elseBranch;
-}
-
 ForLoopStatement::ForLoopStatement(Statement* init, Expression* condition,
     Expression* increment, Statement* body)
-    : m_init(init)
+    : Statement(Kind::ForLoopStatement)
+    , m_init(init)
     , m_condition(condition)
     , m_increment(increment)
     , m_body(body)
 {
 }
 
-ForLoopStatement::~ForLoopStatement()
-{
-    delete m_init;
-    delete m_condition;
-    delete m_increment;
-    delete m_body;
-}
-
 UpdateExpression::UpdateExpression(Operation op, bool prefix, Expression* argument)
-    : m_op(op)
+    : Expression(Kind::UpdateExpression)
+    , m_op(op)
     , m_prefix(prefix)
     , m_argument(argument)
 {
 }
 
-UpdateExpression::~UpdateExpression()
-{
-    delete m_argument;
-}
-
 DoWhileLoopStatement::DoWhileLoopStatement(Expression* condition, Statement* body)
-    : m_condition(condition)
+    : Statement(Kind::DoWhileLoopStatement)
+    , m_condition(condition)
     , m_body(body)
 {
 }
 
-DoWhileLoopStatement::~DoWhileLoopStatement()
-{
-    delete m_condition;
-    delete m_body;
-}
-
 WhileLoopStatement::WhileLoopStatement(Expression* condition, Statement* body)
-    : m_condition(condition)
+    : Statement(Kind::WhileLoopStatement)
+    , m_condition(condition)
     , m_body(body)
 {
 }
 
-WhileLoopStatement::~WhileLoopStatement()
+BreakStatement::BreakStatement()
+    : Statement(Kind::BreakStatement)
 {
-    delete m_condition;
-    delete m_body;
 }
 
-BreakStatement::BreakStatement() { }
-BreakStatement::~BreakStatement() { }
-
-ContinueStatement::ContinueStatement() { }
-ContinueStatement::~ContinueStatement() { }
-
-ArrayMemberExpression::ArrayMemberExpression(Expression* array, Expression* index)
-    : m_array(array)
-    , m_index(index)
-{
-}
-
-ArrayMemberExpression::~ArrayMemberExpression()
+ContinueStatement::ContinueStatement()
+    : Statement(Kind::ContinueStatement)
 {
-    delete m_array;
-    delete m_index;
 }
 
-bool ArrayMemberExpression::isArrayMemberExpression() const
+ArrayMemberExpression::ArrayMemberExpression(Expression* array, Expression* index)
+    : Expression(Kind::ArrayMemberExpression)
+    , m_array(array)
+    , m_index(index)
 {
-    return true;
 }
 
 Expression* ArrayMemberExpression::array() const
@@ -339,18 +266,14 @@ Expression* ArrayMemberExpression::index() const
     return m_index;
 }
 
-MemberExpression::MemberExpression(Expression* object, Identifier* property)
-    : m_object(object)
+MemberExpression::MemberExpression(Expression* object, Identifier* property, size_t line)
+    : Expression(Kind::MemberExpression)
+    , m_object(object)
     , m_property(property)
+    , m_line(line)
 {
 }
 
-MemberExpression::~MemberExpression()
-{
-    delete m_object;
-    delete m_property;
-}
-
 Expression* MemberExpression::object()
 {
     return m_object;
@@ -361,49 +284,52 @@ Identifier* MemberExpression::property()
     return m_property;
 }
 
-bool MemberExpression::isMemberExpression() const
+const Identifier* MemberExpression::property() const
 {
-    return true;
+    return m_property;
 }
 
-ArrayExpression::ArrayExpression(std::vector<Expression*> elements)
-    : m_elements(elements)
+size_t MemberExpression::line() const
 {
+    return m_line;
 }
-ArrayExpression::~ArrayExpression()
+
+InlineCache& MemberExpression::cache() const
 {
-    for (auto& element : m_elements) {
-        delete element;
-    }
+    return m_cache;
 }
 
-ObjectExpression::ObjectExpression(std::vector<ObjectProperty*> properties)
-    : m_properties(properties)
+ArrayExpression::ArrayExpression(AstList<Expression*> elements)
+    : Expression(Kind::ArrayExpression)
+    , m_elements(elements)
 {
 }
-
-ObjectExpression::~ObjectExpression()
+ObjectExpression::ObjectExpression(AstList<ObjectProperty*> properties)
+    : Expression(Kind::ObjectExpression)
+    , m_properties(properties)
 {
-    for (auto& property : m_properties) {
-        delete property;
-    }
 }
 
-const std::vector<ObjectProperty*>& ObjectExpression::properties() const
+const AstList<ObjectProperty*>& ObjectExpression::properties() const
 {
     return m_properties;
 }
 
 ObjectProperty::ObjectProperty(Identifier* name, Expression* value)
-    : m_name(name)
+    : Ast(Kind::ObjectProperty)
+    , m_name(name)
     , m_value(value)
 {
 }
 
-ObjectProperty::~ObjectProperty()
+uint32_t ObjectProperty::offset() const
 {
-    delete m_name;
-    delete m_value;
+    return m_offset;
+}
+
+void ObjectProperty::offset(uint32_t offset)
+{
+    m_offset = offset;
 }
 
 Identifier* ObjectProperty::name()
@@ -416,737 +342,727 @@ Expression* ObjectProperty::value()
     return m_value;
 }
 
-void Program::prettyPrint(int32_t indentLevel) const
+uint32_t Scope::flattenScope(FlatAst& ast, Ast::Kind kind, size_t slotCount) const
 {
-    printIndentation(indentLevel);
-    std::cout << "Program:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- body:" << std::endl;
-    Scope::prettyPrint(indentLevel + 2);
+    std::vector<FlatAst::Index> body;
+    for (auto& statement : m_body) {
+        body.push_back(statement->flatten(ast));
+    }
+    return ast.add(kind, 0, ast.addList(body), body.size(), slotCount);
 }
 
-void BlockStatement::prettyPrint(int32_t indentLevel) const
+uint32_t Program::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "Block:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- body:" << std::endl;
-    Scope::prettyPrint(indentLevel + 2);
+    return flattenScope(ast, kind(), slotCount());
 }
 
-void ExpressionStatement::prettyPrint(int32_t indentLevel) const
+uint32_t BlockStatement::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "ExpressionStatement:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- expression:" << std::endl;
-    m_expression->prettyPrint(indentLevel + 2);
+    return flattenScope(ast, kind(), slotCount());
 }
 
-void Literal::prettyPrint(int32_t indentLevel) const
+uint32_t ExpressionStatement::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "Literal:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- value:" << std::endl;
-    printIndentation(indentLevel + 2);
-    std::cout << m_value << std::endl;
+    return ast.add(kind(), 0, m_expression->flatten(ast));
 }
 
-void BinaryExpression::prettyPrint(int32_t indentLevel) const
+uint32_t Literal::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "BinaryExpression:" << std::endl;
-
-    printIndentation(indentLevel + 1);
-    std::cout << "- op:" << std::endl;
-    printIndentation(indentLevel + 2);
-    std::cout << static_cast<int>(m_op) << std::endl;
-
-    printIndentation(indentLevel + 1);
-    std::cout << "- left:" << std::endl;
-    m_left->prettyPrint(indentLevel + 2);
-
-    printIndentation(indentLevel + 1);
-    std::cout << "- rigth:" << std::endl;
-    m_right->prettyPrint(indentLevel + 2);
+    if (m_isString)
+        return ast.add(kind(), 1, ast.addConstant(m_value), ast.addName(m_string));
+    return ast.add(kind(), 0, ast.addConstant(m_value));
 }
 
-void UnaryExpression::prettyPrint(int32_t indentLevel) const
+uint32_t BinaryExpression::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "UnaryExpression:" << std::endl;
-
-    printIndentation(indentLevel + 1);
-    std::cout << "- op:" << std::endl;
-    printIndentation(indentLevel + 2);
-    std::cout << static_cast<int>(m_op) << std::endl;
+    uint32_t left = m_left->flatten(ast);
+    uint32_t right = m_right->flatten(ast);
+    return ast.add(kind(), static_cast<uint8_t>(m_op), left, right);
+}
 
-    printIndentation(indentLevel + 1);
-    std::cout << "- right:" << std::endl;
-    m_right->prettyPrint(indentLevel + 2);
+uint32_t UnaryExpression::flatten(FlatAst& ast) const
+{
+    return ast.add(kind(), static_cast<uint8_t>(m_op), m_right->flatten(ast));
 }
 
-void Identifier::prettyPrint(int32_t indentLevel) const
+uint32_t Identifier::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "Identifier:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- name:" << std::endl;
-    printIndentation(indentLevel + 2);
-    std::cout << m_name << std::endl;
+    return ast.add(kind(), 0, m_depth, m_slot, ast.addName(m_name));
 }
 
-void FunctionExpression::prettyPrint(int32_t indentLevel) const
+uint32_t FunctionExpression::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "FunctionExpression:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- params:" << std::endl;
-    for (const auto& param : m_params) {
-        param->prettyPrint(indentLevel + 2);
+    std::vector<FlatAst::Index> params;
+    for (auto& param : m_params) {
+        params.push_back(param->flatten(ast));
     }
-    printIndentation(indentLevel + 1);
-    std::cout << "- body:" << std::endl;
-    m_body->prettyPrint(indentLevel + 2);
+    // The body runs directly in the environment of the call.
+    uint32_t body = m_body->flattenScope(ast, Kind::BlockStatement, m_slotCount);
+    return ast.add(kind(), 0, ast.addList(params), params.size(), body);
 }
 
-void ReturnStatement::prettyPrint(int32_t indentLevel) const
+uint32_t ReturnStatement::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "ReturnStatement:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- argument:" << std::endl;
-    if (m_argument)
-        m_argument->prettyPrint(indentLevel + 2);
+    return ast.add(kind(), 0, m_argument ? m_argument->flatten(ast) : FlatAst::NoNode);
 }
 
-void VariableDeclarator::prettyPrint(int32_t indentLevel) const
+uint32_t VariableDeclarator::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "VariableDeclarator:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- name:" << std::endl;
-    m_name->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- init:" << std::endl;
-    m_init->prettyPrint(indentLevel + 2);
+    uint32_t name = m_name->flatten(ast);
+    uint32_t init = m_init->flatten(ast);
+    return ast.add(kind(), 0, name, init);
 }
 
-void VariableDeclaration::prettyPrint(int32_t indentLevel) const
+uint32_t VariableDeclaration::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "VariableDeclaration:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- declarations:" << std::endl;
-    for (const auto& declarator : m_declarators) {
-        declarator->prettyPrint(indentLevel + 2);
+    std::vector<FlatAst::Index> declarators;
+    for (auto& declarator : m_declarators) {
+        declarators.push_back(declarator->flatten(ast));
     }
+    return ast.add(kind(), 0, ast.addList(declarators), declarators.size());
 }
 
-void CallExpression::prettyPrint(int32_t indentLevel) const
+uint32_t CallExpression::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "CallExpression:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- name:" << std::endl;
-    m_name->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- arguments:" << std::endl;
-    for (const auto& param : m_arguments) {
-        param->prettyPrint(indentLevel + 2);
+    uint32_t name = m_name->flatten(ast);
+    std::vector<FlatAst::Index> arguments;
+    for (auto& argument : m_arguments) {
+        arguments.push_back(argument->flatten(ast));
     }
+    return ast.add(kind(), 0, name, ast.addList(arguments), arguments.size());
 }
 
-void PrintStatement::prettyPrint(int32_t indentLevel) const
+uint32_t PrintStatement::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "PrintStatement:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- argument:" << std::endl;
-    m_argument->prettyPrint(indentLevel + 2);
+    return ast.add(kind(), 0, m_argument->flatten(ast));
 }
 
-void AssignmentExpression::prettyPrint(int32_t indentLevel) const
+uint32_t AssignmentExpression::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "AssignmentExpression:" << std::endl;
-
-    printIndentation(indentLevel + 1);
-    std::cout << "- op:" << std::endl;
-    printIndentation(indentLevel + 2);
-    std::cout << static_cast<int>(m_op) << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- left:" << std::endl;
-    m_left->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- rigth:" << std::endl;
-    m_right->prettyPrint(indentLevel + 2);
+    uint32_t left = m_left->flatten(ast);
+    uint32_t right = m_right->flatten(ast);
+    return ast.add(kind(), static_cast<uint8_t>(m_op), left, right);
 }
 
-void LogicalExpression::prettyPrint(int32_t indentLevel) const
+uint32_t LogicalExpression::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "LogicalExpression:" << std::endl;
-
-    printIndentation(indentLevel + 1);
-    std::cout << "- op:" << std::endl;
-    printIndentation(indentLevel + 2);
-    std::cout << static_cast<int>(m_op) << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- left:" << std::endl;
-    m_left->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- rigth:" << std::endl;
-    m_right->prettyPrint(indentLevel + 2);
+    uint32_t left = m_left->flatten(ast);
+    uint32_t right = m_right->flatten(ast);
+    return ast.add(kind(), static_cast<uint8_t>(m_op), left, right);
 }
 
-void IfElseStatement::prettyPrint(int32_t indentLevel) const
+uint32_t IfElseStatement::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "IfElseStatement:" << std::endl;
-
-    printIndentation(indentLevel + 1);
-    std::cout << "- condition:" << std::endl;
-    m_condition->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- ifBranch:" << std::endl;
-    m_ifBranch->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- elseBranch:" << std::endl;
-    if (m_elseBranch)
-        m_elseBranch->prettyPrint(indentLevel + 2);
+    uint32_t condition = m_condition->flatten(ast);
+    uint32_t ifBranch = m_ifBranch->flatten(ast);
+    uint32_t elseBranch = m_elseBranch ? m_elseBranch->flatten(ast) : FlatAst::NoNode;
+    return ast.add(kind(), 0, condition, ifBranch, elseBranch);
 }
 
-void ForLoopStatement::prettyPrint(int32_t indentLevel) const
+uint32_t ForLoopStatement::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "ForLoopStatement:" << std::endl;
-
-    printIndentation(indentLevel + 1);
-    std::cout << "- init:" << std::endl;
-    if (m_init)
-        m_init->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- condition:" << std::endl;
-    if (m_condition)
-        m_condition->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- incremenet:" << std::endl;
-    if (m_increment)
-        m_increment->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- body:" << std::endl;
-    m_body->prettyPrint(indentLevel + 2);
+    std::vector<FlatAst::Index> parts = {
+        m_init ? m_init->flatten(ast) : FlatAst::NoNode,
+        m_condition ? m_condition->flatten(ast) : FlatAst::NoNode,
+        m_increment ? m_increment->flatten(ast) : FlatAst::NoNode,
+        m_body->flatten(ast)
+    };
+    return ast.add(kind(), 0, ast.addList(parts), m_slotCount);
 }
 
-void ObjectProperty::prettyPrint(int32_t indentLevel) const
+uint32_t WhileLoopStatement::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "ObjectProperty:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- name:" << std::endl;
-    m_name->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- value:" << std::endl;
-    m_value->prettyPrint(indentLevel + 2);
+    uint32_t condition = m_condition ? m_condition->flatten(ast) : FlatAst::NoNode;
+    uint32_t body = m_body->flatten(ast);
+    return ast.add(kind(), 0, condition, body);
 }
 
-void ObjectExpression::prettyPrint(int32_t indentLevel) const
+uint32_t DoWhileLoopStatement::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "ObjectExpression:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- properties:" << std::endl;
-    for (const auto& property : m_properties) {
-        property->prettyPrint(indentLevel + 2);
-    }
+    uint32_t condition = m_condition ? m_condition->flatten(ast) : FlatAst::NoNode;
+    uint32_t body = m_body->flatten(ast);
+    return ast.add(kind(), 0, condition, body);
 }
 
-void MemberExpression::prettyPrint(int32_t indentLevel) const
+uint32_t ObjectProperty::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "MemberExpression:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- object:" << std::endl;
-    m_object->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- property:" << std::endl;
-    m_property->prettyPrint(indentLevel + 2);
+    uint32_t name = m_name->flatten(ast);
+    uint32_t value = m_value->flatten(ast);
+    return ast.add(kind(), 0, name, value, m_offset);
 }
 
-void ArrayExpression::prettyPrint(int32_t indentLevel) const
+uint32_t ObjectExpression::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "ArrayExpression:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- elements:" << std::endl;
-    for (const auto& element : m_elements) {
-        element->prettyPrint(indentLevel + 2);
+    std::vector<FlatAst::Index> properties;
+    for (auto& property : m_properties) {
+        properties.push_back(property->flatten(ast));
     }
+    return ast.add(kind(), 0, ast.addList(properties), properties.size(), ast.addShape(m_shape));
 }
 
-void ArrayMemberExpression::prettyPrint(int32_t indentLevel) const
+uint32_t MemberExpression::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "ArrayMememebrExpression:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- array:" << std::endl;
-    m_array->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- index:" << std::endl;
-    printIndentation(indentLevel + 2);
-    std::cout << m_index << std::endl;
+    uint32_t object = m_object->flatten(ast);
+    uint32_t property = m_property->flatten(ast);
+    return ast.add(kind(), 0, object, property, ast.addSite(m_property->key(), &m_cache));
 }
 
-void ContinueStatement::prettyPrint(int32_t indentLevel) const
+uint32_t ArrayExpression::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "ContinueExpression:" << std::endl;
+    std::vector<FlatAst::Index> elements;
+    for (auto& element : m_elements) {
+        elements.push_back(element->flatten(ast));
+    }
+    return ast.add(kind(), 0, ast.addList(elements), elements.size());
 }
 
-void BreakStatement::prettyPrint(int32_t indentLevel) const
+uint32_t ArrayMemberExpression::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "BreakExpression:" << std::endl;
+    uint32_t array = m_array->flatten(ast);
+    uint32_t index = m_index->flatten(ast);
+    return ast.add(kind(), 0, array, index);
 }
 
-void WhileLoopStatement::prettyPrint(int32_t indentLevel) const
+uint32_t ContinueStatement::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "WhileLoopStatement:" << std::endl;
-
-    printIndentation(indentLevel + 1);
-    std::cout << "- condition:" << std::endl;
-    if (m_condition)
-        m_condition->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- body:" << std::endl;
-    m_body->prettyPrint(indentLevel + 2);
+    return ast.add(kind());
 }
 
-void DoWhileLoopStatement::prettyPrint(int32_t indentLevel) const
+uint32_t BreakStatement::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "DoWhileLoopStatement:" << std::endl;
-
-    printIndentation(indentLevel + 1);
-    std::cout << "- condition:" << std::endl;
-    if (m_condition)
-        m_condition->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- body:" << std::endl;
-    m_body->prettyPrint(indentLevel + 2);
+    return ast.add(kind());
 }
 
-void UpdateExpression::prettyPrint(int32_t indentLevel) const
+uint32_t UpdateExpression::flatten(FlatAst& ast) const
 {
-    printIndentation(indentLevel);
-    std::cout << "UpdateExpression:" << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- argument:" << std::endl;
-    m_argument->prettyPrint(indentLevel + 2);
-    printIndentation(indentLevel + 1);
-    std::cout << "- operator:" << std::endl;
-    printIndentation(indentLevel + 2);
-    std::cout << static_cast<int>(m_op) << std::endl;
-    printIndentation(indentLevel + 1);
-    std::cout << "- prefix:" << std::endl;
-    printIndentation(indentLevel + 2);
-    std::cout << m_prefix << std::endl;
+    return ast.add(kind(), static_cast<uint8_t>(m_op), m_argument->flatten(ast), m_prefix);
 }
 
-std::optional<Value> Scope::execute(Interpreter& interpreter) const
+void Scope::compileBody(Compiler& compiler) const
 {
-    interpreter.stack().push_back({});
     for (auto& statement : m_body) {
-        statement->execute(interpreter);
+        statement->compile(compiler);
     }
-    interpreter.stack().pop_back();
-
-    return std::nullopt;
 }
 
-std::optional<Value> Scope::execute(Interpreter& interpreter,
-    std::unordered_map<std::string, Value> environment) const
+void Program::compile(Compiler& compiler) const
 {
-    interpreter.stack().push_back(environment);
-    for (auto& statement : m_body) {
-        statement->execute(interpreter);
-    }
-    interpreter.stack().pop_back();
+    compileBody(compiler);
+}
 
-    return std::nullopt;
+void BlockStatement::compile(Compiler& compiler) const
+{
+    compiler.beginScope(slotCount());
+    compileBody(compiler);
+    compiler.endScope(slotCount());
 }
 
-std::optional<Value> ExpressionStatement::execute(Interpreter& interpreter) const
+void ExpressionStatement::compile(Compiler& compiler) const
 {
-    m_expression->execute(interpreter);
-    return std::nullopt;
+    m_expression->compile(compiler);
+    compiler.emit(OpCode::Pop);
 }
 
-std::optional<Value> Literal::execute(Interpreter&) const
+void Literal::compile(Compiler& compiler) const
 {
-    return m_value;
+    compiler.emitConstant(m_value);
 }
 
-std::optional<Value> BinaryExpression::execute(Interpreter& interpreter) const
+void BinaryExpression::compile(Compiler& compiler) const
 {
-    Value left = m_left->execute(interpreter).value();
-    Value right = m_right->execute(interpreter).value();
+    m_left->compile(compiler);
+    m_right->compile(compiler);
     switch (m_op) {
     case Operator::Addition:
-        return left + right;
+        compiler.emit(OpCode::Add);
+        break;
     case Operator::Subtraction:
-        return left - right;
+        compiler.emit(OpCode::Subtract);
+        break;
     case Operator::Multiplication:
-        return left * right;
+        compiler.emit(OpCode::Multiply);
+        break;
     case Operator::Division:
-        return left / right;
+        compiler.emit(OpCode::Divide);
+        break;
     case Operator::Modulo:
-        return left % right;
+        compiler.emit(OpCode::Modulo);
+        break;
     case Operator::Equals:
-        return left == right;
+        compiler.emit(OpCode::Equal);
+        break;
     case Operator::Inequals:
-        return left != right;
+        compiler.emit(OpCode::NotEqual);
+        break;
     case Operator::GreaterThan:
-        return left > right;
+        compiler.emit(OpCode::Greater);
+        break;
     case Operator::LessThan:
-        return left < right;
+        compiler.emit(OpCode::Less);
+        break;
     case Operator::GreaterThanEquals:
-        return left >= right;
+        compiler.emit(OpCode::GreaterEqual);
+        break;
     case Operator::LessThanEquals:
-        return left <= right;
+        compiler.emit(OpCode::LessEqual);
+        break;
     }
-
-    assert(false);
 }
 
-std::optional<Value> UnaryExpression::execute(Interpreter& interpreter) const
+void UnaryExpression::compile(Compiler& compiler) const
 {
-    Value right = m_right->execute(interpreter).value();
+    m_right->compile(compiler);
     switch (m_op) {
     case Operator::Not:
-        return Value(!right.toBoolean());
+        compiler.emit(OpCode::Not);
+        break;
     case Operator::Plus:
-        return Value(right.toNumber());
+        compiler.emit(OpCode::Plus);
+        break;
     case Operator::Minus:
-        return Value(-right.toNumber());
+        compiler.emit(OpCode::Negate);
+        break;
     }
-    return std::nullopt;
 }
 
-std::optional<Value> Identifier::execute(Interpreter& interpreter) const
+void Identifier::compile(Compiler& compiler) const
 {
-    Value value = interpreter.getVariable(m_name);
-    return value;
+    compiler.emitVariable(OpCode::GetVariable, this);
 }
 
-std::optional<Value> FunctionExpression::execute(Interpreter& interpreter) const
+void FunctionExpression::compile(Compiler& compiler) const
 {
     std::vector<std::string> params = {};
     for (auto& param : m_params) {
-        params.push_back(param->name());
+        params.emplace_back(param->name());
     }
-
-    auto function = interpreter.heap().allocate<Msl::Function>(m_body, params);
-    return Value(function);
+    compiler.emitFunction(m_body, params, m_slotCount);
 }
 
-std::optional<Value> ReturnStatement::execute(Interpreter& interpreter) const
+void ReturnStatement::compile(Compiler& compiler) const
 {
-    Value ret;
     if (m_argument)
-        ret = m_argument->execute(interpreter).value();
-    interpreter.stack().pop_back();
-    throw ReturnException(ret);
-
-    return std::nullopt;
+        m_argument->compile(compiler);
+    else
+        compiler.emit(OpCode::Null);
+    compiler.emit(OpCode::Return);
 }
 
-std::optional<Value> VariableDeclarator::execute(Interpreter& interpreter) const
+void VariableDeclarator::compile(Compiler& compiler) const
 {
-    Value init = m_init->execute(interpreter).value();
-    interpreter.declareVariable(m_name->name(), init);
-    return std::nullopt;
+    m_init->compile(compiler);
+    compiler.emitVariable(OpCode::DeclareVariable, m_name);
 }
 
-std::optional<Value> VariableDeclaration::execute(Interpreter& interpreter) const
+void VariableDeclaration::compile(Compiler& compiler) const
 {
     for (auto& declarator : m_declarators) {
-        declarator->execute(interpreter);
+        declarator->compile(compiler);
     }
-    return std::nullopt;
 }
 
-std::optional<Value> CallExpression::execute(Interpreter& interpreter) const
+void CallExpression::compile(Compiler& compiler) const
 {
-    Value function = m_name->execute(interpreter).value();
-    if (!function.isFunction()) {
-        throw RuntimeException("Trying to call a non function value");
-    }
-    if (!function.function()->variadic()
-        && function.function()->paramCount() != m_arguments.size()) {
-        throw RuntimeException("Invalid number of parameters to function");
+    if (m_arguments.size() > UINT8_MAX) {
+        throw RuntimeException("Too many arguments to function");
     }
-    std::vector<Value> args = {};
+    m_name->compile(compiler);
     for (auto& argument : m_arguments) {
-        args.push_back(argument->execute(interpreter).value());
+        argument->compile(compiler);
     }
-    Value ret = function.function()->execute(interpreter, args);
-    return ret;
+    compiler.emit(OpCode::Call);
+    compiler.emitByte(m_arguments.size());
 }
 
-std::optional<Value> PrintStatement::execute(Interpreter& interpreter) const
+void PrintStatement::compile(Compiler& compiler) const
 {
-    std::cout << m_argument->execute(interpreter).value() << std::endl;
-    return std::nullopt;
+    m_argument->compile(compiler);
+    compiler.emit(OpCode::Print);
 }
 
-std::optional<Value> AssignmentExpression::execute(Interpreter& interpreter) const
+void AssignmentExpression::compile(Compiler& compiler) const
 {
-    Value value = m_right->execute(interpreter).value();
+    m_right->compile(compiler);
 
-    if (m_left->isIdentifier()) {
-        auto old = static_cast<Identifier*>(m_left)->execute(interpreter).value();
-        std::string name = static_cast<Identifier*>(m_left)->name();
-        switch (m_op) {
-        case Operator::Equals:
-            return interpreter.updateVariable(name, value);
-        case Operator::PlusEquals:
-            return interpreter.updateVariable(name, old + value);
-        case Operator::MinusEquals:
-            return interpreter.updateVariable(name, old - value);
-        case Operator::AsteriskEquals:
-            return interpreter.updateVariable(name, old * value);
-        case Operator::SlashEquals:
-            return interpreter.updateVariable(name, old / value);
-        case Operator::ModuloEquals:
-            return interpreter.updateVariable(name, old % value);
-        }
+    if (m_left->kind() == Kind::Identifier) {
+        compiler.emitVariable(OpCode::AssignVariable, static_cast<Identifier*>(m_left));
+    } else if (m_left->kind() == Kind::MemberExpression) {
+        auto member = static_cast<MemberExpression*>(m_left);
+        member->object()->compile(compiler);
+        compiler.emitProperty(OpCode::AssignProperty, member);
+    } else if (m_left->kind() == Kind::ArrayMemberExpression) {
+        auto member = static_cast<ArrayMemberExpression*>(m_left);
+        member->array()->compile(compiler);
+        member->index()->compile(compiler);
+        compiler.emit(OpCode::AssignElement);
+    } else {
+        throw RuntimeException("Assignment left expression is not an identifier or object property or array");
     }
+    compiler.emitByte(static_cast<uint8_t>(m_op));
+}
 
-    if (m_left->isMemberExpression()) {
-        Value object = static_cast<MemberExpression*>(m_left)->object()->execute(interpreter).value();
-        std::string property = static_cast<MemberExpression*>(m_left)->property()->name();
-        if (!object.isObject())
-            throw RuntimeException("Assignment left expresion is not an object");
-        Object* obj = object.object();
-        auto old = obj->get(property);
-        switch (m_op) {
-        case Operator::Equals:
-            return obj->set(property, value);
-        case Operator::PlusEquals:
-            return obj->set(property, old + value);
-        case Operator::MinusEquals:
-            return obj->set(property, old - value);
-        case Operator::AsteriskEquals:
-            return obj->set(property, old * value);
-        case Operator::SlashEquals:
-            return obj->set(property, old / value);
-        case Operator::ModuloEquals:
-            return obj->set(property, old % value);
-        }
+void LogicalExpression::compile(Compiler& compiler) const
+{
+    m_left->compile(compiler);
+    size_t jump = compiler.emitJump(m_op == Operator::And
+            ? OpCode::JumpIfFalseOrPop
+            : OpCode::JumpIfTrueOrPop);
+    m_right->compile(compiler);
+    compiler.patchJump(jump);
+}
+
+void IfElseStatement::compile(Compiler& compiler) const
+{
+    m_condition->compile(compiler);
+    size_t elseJump = compiler.emitJump(OpCode::JumpIfFalse);
+    m_ifBranch->compile(compiler);
+    if (m_elseBranch) {
+        size_t endJump = compiler.emitJump(OpCode::Jump);
+        compiler.patchJump(elseJump);
+        m_elseBranch->compile(compiler);
+        compiler.patchJump(endJump);
+    } else {
+        compiler.patchJump(elseJump);
     }
+}
+
+void ForLoopStatement::compile(Compiler& compiler) const
+{
+    compiler.beginScope(m_slotCount);
+    if (m_init)
+        m_init->compile(compiler);
 
-    if (m_left->isArrayMemberExpression()) {
-        Value array = static_cast<ArrayMemberExpression*>(m_left)->array()->execute(interpreter).value();
-        Value indexValue = static_cast<ArrayMemberExpression*>(m_left)->index()->execute(interpreter).value();
-        if (!array.isArray())
-            throw RuntimeException("Assignment left expression is not an array");
-        if (!indexValue.isNumber())
-            throw RuntimeException("Can't use non number to access array element");
-        Array* arr = array.array();
-        size_t index = indexValue.number();
-        auto old = arr->at(index);
-        switch (m_op) {
-        case Operator::Equals:
-            return arr->at(index, value);
-        case Operator::PlusEquals:
-            return arr->at(index, old + value);
-        case Operator::MinusEquals:
-            return arr->at(index, old - value);
-        case Operator::AsteriskEquals:
-            return arr->at(index, old * value);
-        case Operator::SlashEquals:
-            return arr->at(index, old / value);
-        case Operator::ModuloEquals:
-            return arr->at(index, old % value);
-        }
+    size_t start = compiler.currentOffset();
+    size_t exitJump = 0;
+    if (m_condition) {
+        m_condition->compile(compiler);
+        exitJump = compiler.emitJump(OpCode::JumpIfFalse);
     }
 
-    throw RuntimeException("Assignment left expression is not an identifier or object property or array");
+    compiler.beginLoop();
+    m_body->compile(compiler);
+    compiler.patchContinues();
+    if (m_increment) {
+        m_increment->compile(compiler);
+        compiler.emit(OpCode::Pop);
+    }
+    compiler.emitLoop(start);
+
+    if (m_condition)
+        compiler.patchJump(exitJump);
+    compiler.endLoop();
+    compiler.endScope(m_slotCount);
 }
 
-std::optional<Value> LogicalExpression::execute(Interpreter& interpreter) const
+void WhileLoopStatement::compile(Compiler& compiler) const
 {
-    Value left = m_left->execute(interpreter).value();
+    size_t start = compiler.currentOffset();
+    size_t exitJump = 0;
+    if (m_condition) {
+        m_condition->compile(compiler);
+        exitJump = compiler.emitJump(OpCode::JumpIfFalse);
+    }
 
-    switch (m_op) {
-    case Operator::And:
-        if (!left.toBoolean())
-            return left;
-        break;
-    case Operator::Or:
-        if (left.toBoolean())
-            return left;
-        break;
+    compiler.beginLoop();
+    compiler.setContinueTarget(start);
+    m_body->compile(compiler);
+    compiler.emitLoop(start);
+
+    if (m_condition)
+        compiler.patchJump(exitJump);
+    compiler.endLoop();
+}
+
+void DoWhileLoopStatement::compile(Compiler& compiler) const
+{
+    size_t start = compiler.currentOffset();
+
+    compiler.beginLoop();
+    m_body->compile(compiler);
+    compiler.patchContinues();
+    if (m_condition) {
+        m_condition->compile(compiler);
+        size_t exitJump = compiler.emitJump(OpCode::JumpIfFalse);
+        compiler.emitLoop(start);
+        compiler.patchJump(exitJump);
+    } else {
+        compiler.emitLoop(start);
     }
+    compiler.endLoop();
+}
 
-    return m_right->execute(interpreter).value();
+void ObjectProperty::compile(Compiler& compiler) const
+{
+    m_value->compile(compiler);
+    compiler.emit(OpCode::InitProperty);
+    compiler.emitShort(m_offset);
 }
 
-std::optional<Value> IfElseStatement::execute(Interpreter& interpreter) const
+void ObjectExpression::compile(Compiler& compiler) const
 {
-    bool condition = m_condition->execute(interpreter).value().toBoolean();
-    if (condition)
-        m_ifBranch->execute(interpreter);
-    else if (m_elseBranch)
-        m_elseBranch->execute(interpreter);
+    compiler.emitShape(m_shape);
+    for (auto& property : m_properties) {
+        property->compile(compiler);
+    }
+}
 
-    return std::nullopt;
+void MemberExpression::compile(Compiler& compiler) const
+{
+    m_object->compile(compiler);
+    compiler.emitProperty(OpCode::GetProperty, this);
 }
 
-std::optional<Value> ForLoopStatement::execute(Interpreter& interpreter) const
+void ArrayExpression::compile(Compiler& compiler) const
 {
-    interpreter.stack().push_back({});
-    for (m_init ? m_init->execute(interpreter) : true;
-         m_condition ? m_condition->execute(interpreter).value().toBoolean() : true;
-         m_increment ? m_increment->execute(interpreter) : true) {
-        try {
-            m_body->execute(interpreter);
-        } catch (ContinueException&) {
-            continue;
-        } catch (BreakException&) {
-            break;
-        }
+    if (m_elements.size() > UINT16_MAX) {
+        throw RuntimeException("Too many elements in array literal");
     }
-    interpreter.stack().pop_back();
+    for (auto& element : m_elements) {
+        element->compile(compiler);
+    }
+    compiler.emit(OpCode::NewArray);
+    compiler.emitShort(m_elements.size());
+}
 
-    return std::nullopt;
+void ArrayMemberExpression::compile(Compiler& compiler) const
+{
+    m_array->compile(compiler);
+    m_index->compile(compiler);
+    compiler.emit(OpCode::GetElement);
 }
 
-std::optional<Value> ObjectProperty::execute(Interpreter&) const
+void ContinueStatement::compile(Compiler& compiler) const
 {
-    assert(false); // I should never ever run this
+    compiler.emitContinue();
 }
 
-std::optional<Value> ObjectExpression::execute(Interpreter& interpreter) const
+void BreakStatement::compile(Compiler& compiler) const
 {
-    auto object = interpreter.heap().allocate<Object>();
-    for (auto& property : m_properties) {
-        interpreter.heap().disableGC();
-        object->set(property->name()->name(),
-            property->value()->execute(interpreter).value());
-        interpreter.heap().enableGC();
+    compiler.emitBreak();
+}
+
+void UpdateExpression::compile(Compiler& compiler) const
+{
+    uint8_t flags = 0;
+    if (m_op == Operation::Increment)
+        flags |= UpdateIncrement;
+    if (m_prefix)
+        flags |= UpdatePrefix;
+
+    if (m_argument->kind() == Kind::Identifier) {
+        compiler.emitVariable(OpCode::UpdateVariable, static_cast<Identifier*>(m_argument));
+    } else if (m_argument->kind() == Kind::MemberExpression) {
+        auto member = static_cast<MemberExpression*>(m_argument);
+        member->object()->compile(compiler);
+        compiler.emitProperty(OpCode::UpdateProperty, member);
+    } else if (m_argument->kind() == Kind::ArrayMemberExpression) {
+        auto member = static_cast<ArrayMemberExpression*>(m_argument);
+        member->array()->compile(compiler);
+        member->index()->compile(compiler);
+        compiler.emit(OpCode::UpdateElement);
+    } else {
+        throw RuntimeException("Assignment left expression is not an object, array or identifier");
     }
-    return object;
+    compiler.emitByte(flags);
 }
 
-std::optional<Value> MemberExpression::execute(Interpreter& interpreter) const
+void Scope::resolveBody(Resolver& resolver)
 {
-    auto object = m_object->execute(interpreter).value();
-    if (!object.isObject()) {
-        return Value();
+    resolver.hoist(m_body);
+    for (auto& statement : m_body) {
+        statement->resolve(resolver);
     }
-    return object.object()->get(m_property->name());
 }
 
-std::optional<Value> ArrayExpression::execute(Interpreter& interpreter) const
+void Program::resolve(Resolver& resolver)
 {
-    auto array = interpreter.heap().allocate<Array>();
-    for (auto& element : m_elements) {
-        interpreter.heap().disableGC();
-        Value value = element->execute(interpreter).value();
-        array->elements().push_back(value);
-        interpreter.heap().enableGC();
+    resolveBody(resolver);
+}
+
+void BlockStatement::resolve(Resolver& resolver)
+{
+    resolver.beginScope();
+    resolveBody(resolver);
+    slotCount(resolver.endScope());
+}
+
+void ExpressionStatement::resolve(Resolver& resolver)
+{
+    m_expression->resolve(resolver);
+}
+
+void Literal::resolve(Resolver& resolver)
+{
+    if (m_isString)
+        m_value = Value(resolver.intern(m_string));
+}
+
+void BinaryExpression::resolve(Resolver& resolver)
+{
+    m_left->resolve(resolver);
+    m_right->resolve(resolver);
+}
+
+void UnaryExpression::resolve(Resolver& resolver)
+{
+    m_right->resolve(resolver);
+}
+
+void Identifier::resolve(Resolver& resolver)
+{
+    resolver.bind(this);
+}
+
+void FunctionExpression::resolve(Resolver& resolver)
+{
+    resolver.beginFunction();
+    for (auto& param : m_params) {
+        resolver.declare(param->name());
     }
-    return Value(array);
+    m_body->resolveBody(resolver);
+    m_slotCount = resolver.endFunction();
 }
 
-std::optional<Value> ArrayMemberExpression::execute(Interpreter& interpreter) const
+void ReturnStatement::resolve(Resolver& resolver)
 {
-    Value value = m_array->execute(interpreter).value();
-    Value index = m_index->execute(interpreter).value();
-    if (!value.isArray())
-        throw RuntimeException("ArrayMemeberExpression on a non array value");
-    if (!index.isNumber())
-        throw RuntimeException("Can't use non number index on array");
-    return value.array()->at(index.number());
+    if (m_argument)
+        m_argument->resolve(resolver);
 }
 
-std::optional<Value> ContinueStatement::execute(Interpreter&) const
+void VariableDeclarator::resolve(Resolver& resolver)
 {
-    throw ContinueException();
+    // The initializer runs before the name is bound.
+    m_init->resolve(resolver);
+    resolver.define(m_name->name());
+    m_name->resolve(resolver);
 }
 
-std::optional<Value> BreakStatement::execute(Interpreter&) const
+void VariableDeclaration::resolve(Resolver& resolver)
 {
-    throw BreakException();
+    for (auto& declarator : m_declarators) {
+        declarator->resolve(resolver);
+    }
 }
 
-std::optional<Value> WhileLoopStatement::execute(Interpreter& interpreter) const
+void CallExpression::resolve(Resolver& resolver)
 {
-    interpreter.stack().push_back({});
-    while (m_condition ? m_condition->execute(interpreter).value().toBoolean() : true) {
-        try {
-            m_body->execute(interpreter);
-        } catch (ContinueException&) {
-            continue;
-        } catch (BreakException&) {
-            break;
-        }
+    m_name->resolve(resolver);
+    for (auto& argument : m_arguments) {
+        argument->resolve(resolver);
     }
-    interpreter.stack().pop_back();
-
-    return std::nullopt;
-}
-
-std::optional<Value> DoWhileLoopStatement::execute(Interpreter& interpreter) const
-{
-    do {
-        try {
-            m_body->execute(interpreter);
-        } catch (ContinueException&) {
-            continue;
-        } catch (BreakException&) {
-            break;
-        }
-    } while (m_condition ? m_condition->execute(interpreter).value().toBoolean() : true);
-
-    return std::nullopt;
-}
-
-std::optional<Value> UpdateExpression::execute(Interpreter& interpreter) const
-{
-    Value oldVal = m_argument->execute(interpreter).value();
-    if (!oldVal.isNumber())
-        throw RuntimeException("Can't incremenet/decrement non numbre variables");
-    Value newVal = m_op == Operation::Increment ? oldVal + Value(1) : oldVal - Value(1);
-
-    if (m_argument->isIdentifier()) {
-        interpreter.updateVariable(static_cast<Identifier*>(m_argument)->name(), newVal);
-    } else if (m_argument->isMemberExpression()) {
-        Value object = static_cast<MemberExpression*>(m_argument)->object()->execute(interpreter).value();
-        std::string property = static_cast<MemberExpression*>(m_argument)->property()->name();
-        if (!object.isObject())
-            throw RuntimeException("Assignment left expresion is not an object");
-        Object* obj = object.object();
-        obj->set(property, newVal);
-    } else if (m_argument->isArrayMemberExpression()) {
-        Value array = static_cast<ArrayMemberExpression*>(m_argument)->array()->execute(interpreter).value();
-        Value index = static_cast<ArrayMemberExpression*>(m_argument)->index()->execute(interpreter).value();
-        if (index.isNumber())
-            throw RuntimeException("Array index isn't a number");
-        if (!array.isArray())
-            throw RuntimeException("not an Array");
-        Array* arr = array.array();
-        arr->at(index.number(), newVal);
-    } else {
-        throw RuntimeException("Assignment left expression is not an object, array or identifier");
+}
+
+void PrintStatement::resolve(Resolver& resolver)
+{
+    m_argument->resolve(resolver);
+}
+
+void AssignmentExpression::resolve(Resolver& resolver)
+{
+    m_left->resolve(resolver);
+    m_right->resolve(resolver);
+}
+
+void LogicalExpression::resolve(Resolver& resolver)
+{
+    m_left->resolve(resolver);
+    m_right->resolve(resolver);
+}
+
+void IfElseStatement::resolve(Resolver& resolver)
+{
+    m_condition->resolve(resolver);
+    m_ifBranch->resolve(resolver);
+    if (m_elseBranch)
+        m_elseBranch->resolve(resolver);
+}
+
+void ForLoopStatement::resolve(Resolver& resolver)
+{
+    resolver.beginScope();
+    if (m_init) {
+        resolver.hoist(m_init);
+        m_init->resolve(resolver);
+    }
+    if (m_condition)
+        m_condition->resolve(resolver);
+    if (m_increment)
+        m_increment->resolve(resolver);
+    resolver.beginLoop();
+    m_body->resolve(resolver);
+    resolver.endLoop();
+    m_slotCount = resolver.endScope();
+}
+
+void WhileLoopStatement::resolve(Resolver& resolver)
+{
+    if (m_condition)
+        m_condition->resolve(resolver);
+    resolver.beginLoop();
+    m_body->resolve(resolver);
+    resolver.endLoop();
+}
+
+void DoWhileLoopStatement::resolve(Resolver& resolver)
+{
+    resolver.beginLoop();
+    m_body->resolve(resolver);
+    resolver.endLoop();
+    if (m_condition)
+        m_condition->resolve(resolver);
+}
+
+void ObjectProperty::resolve(Resolver& resolver)
+{
+    m_name->key(resolver.intern(m_name->name()));
+    m_value->resolve(resolver);
+}
+
+void ObjectExpression::resolve(Resolver& resolver)
+{
+    m_shape = resolver.emptyShape();
+    for (auto& property : m_properties) {
+        property->resolve(resolver);
+        String* key = property->name()->key();
+        if (m_shape->offset(key) == Shape::NotFound)
+            m_shape = m_shape->addProperty(key);
+        property->offset(m_shape->offset(key));
+    }
+}
+
+void MemberExpression::resolve(Resolver& resolver)
+{
+    m_object->resolve(resolver);
+    m_property->key(resolver.intern(m_property->name()));
+    resolver.addPropertySite(this);
+}
+
+void ArrayExpression::resolve(Resolver& resolver)
+{
+    for (auto& element : m_elements) {
+        element->resolve(resolver);
     }
+}
 
-    return m_prefix ? newVal : oldVal;
+void ArrayMemberExpression::resolve(Resolver& resolver)
+{
+    m_array->resolve(resolver);
+    m_index->resolve(resolver);
+}
+
+void ContinueStatement::resolve(Resolver& resolver)
+{
+    resolver.jump("continue");
+}
+
+void BreakStatement::resolve(Resolver& resolver)
+{
+    resolver.jump("break");
+}
+
+void UpdateExpression::resolve(Resolver& resolver)
+{
+    m_argument->resolve(resolver);
 }
 
 }
@@ -1,9 +1,11 @@
 #pragma once
 
+#include "astarena.hpp"
+#include "inlinecache.hpp"
 #include "value.hpp"
 
 #include <memory>
-#include <optional>
+#include <string_view>
 #include <unordered_map>
 #include <vector>
 
@@ -14,59 +16,111 @@ namespace Msl {
 
 class Ast {
 public:
-    virtual std::optional<Value> execute(Interpreter& interpreter) const = 0;
-    virtual void prettyPrint(int32_t indentLevel) const = 0;
-    virtual bool isIdentifier() const;
-    virtual bool isMemberExpression() const;
-    virtual bool isArrayMemberExpression() const;
+    // The concrete class of a node, checked instead of a dynamic_cast or a
+    // virtual query where code needs to know what it holds.
+    enum class Kind : uint8_t {
+        Program,
+        BlockStatement,
+        ExpressionStatement,
+        Literal,
+        BinaryExpression,
+        UnaryExpression,
+        Identifier,
+        FunctionExpression,
+        ReturnStatement,
+        VariableDeclarator,
+        VariableDeclaration,
+        CallExpression,
+        PrintStatement,
+        AssignmentExpression,
+        LogicalExpression,
+        IfElseStatement,
+        ForLoopStatement,
+        WhileLoopStatement,
+        DoWhileLoopStatement,
+        ObjectProperty,
+        ObjectExpression,
+        MemberExpression,
+        ArrayExpression,
+        ArrayMemberExpression,
+        ContinueStatement,
+        BreakStatement,
+        UpdateExpression
+    };
+
+    Kind kind() const { return m_kind; }
+
+    // Appends the node to the flat encoding the tree-walking engine runs
+    // and returns its index there.
+    virtual uint32_t flatten(FlatAst& ast) const = 0;
+    virtual void compile(Compiler& compiler) const = 0;
+    virtual void resolve(Resolver& resolver) = 0;
 
 protected:
-    Ast();
-    virtual ~Ast();
+    // Nodes live in an AstArena and are never deleted through a base.
+    explicit Ast(Kind kind)
+        : m_kind(kind)
+    {
+    }
+    ~Ast() = default;
+
+private:
+    Kind m_kind;
 };
 
-class Statement : public virtual Ast {
-public:
+class Statement : public Ast {
+protected:
+    using Ast::Ast;
 };
 
 class Expression : public Ast {
-public:
+protected:
+    using Ast::Ast;
 };
 
-class Scope : public virtual Ast {
+// The statement list and variable slots shared by Program and BlockStatement.
+class Scope {
 public:
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    std::optional<Value> execute(Interpreter& interpreter,
-        std::unordered_map<std::string, Value> environment) const;
-    virtual void prettyPrint(int32_t indentLevel) const override;
-    void append(Statement* statement);
-    virtual ~Scope();
+    uint32_t flattenScope(FlatAst& ast, Ast::Kind kind, size_t slotCount) const;
+    void compileBody(Compiler& compiler) const;
+    void resolveBody(Resolver& resolver);
+    size_t slotCount() const;
+    void slotCount(size_t count);
 
 protected:
-    explicit Scope(std::vector<Statement*> body);
+    explicit Scope(AstList<Statement*> body);
 
 private:
-    std::vector<Statement*> m_body;
+    AstList<Statement*> m_body;
+    size_t m_slotCount { 0 };
 };
 
-class Program final : public Scope {
+// Owns the arena all nodes of the parse were allocated in.
+class Program final : public Ast, public Scope {
 public:
-    explicit Program(std::vector<Statement*> body);
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    Program(AstList<Statement*> body, std::unique_ptr<AstArena> arena);
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
+
+private:
+    std::unique_ptr<AstArena> m_arena;
 };
 
 class BlockStatement final : public Statement, public Scope {
 public:
-    explicit BlockStatement(std::vector<Statement*> body);
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    explicit BlockStatement(AstList<Statement*> body);
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 };
 
 class ExpressionStatement final : public Statement {
 public:
     explicit ExpressionStatement(Expression* expression);
-    ~ExpressionStatement();
-    std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Expression* m_expression;
@@ -75,11 +129,16 @@ private:
 class Literal final : public Expression {
 public:
     explicit Literal(Value value);
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    explicit Literal(std::string_view string);
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Value m_value;
+    // String literals keep their text until the resolver interns it.
+    bool m_isString { false };
+    std::string_view m_string;
 };
 
 class BinaryExpression final : public Expression {
@@ -99,9 +158,9 @@ public:
     };
 
     explicit BinaryExpression(Operator op, Expression* left, Expression* right);
-    ~BinaryExpression();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Operator m_op;
@@ -118,9 +177,9 @@ public:
     };
 
     explicit UnaryExpression(Operator op, Expression* right);
-    ~UnaryExpression();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Operator m_op;
@@ -129,36 +188,49 @@ private:
 
 class Identifier final : public Expression {
 public:
-    explicit Identifier(const std::string& name);
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
-    const std::string& name() const;
-    virtual bool isIdentifier() const override;
+    static constexpr uint32_t Unresolved = UINT32_MAX;
+
+    explicit Identifier(std::string_view name);
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
+    std::string_view name() const;
+    void bind(uint32_t depth, uint32_t slot);
+    bool resolved() const;
+    uint32_t depth() const;
+    uint32_t slot() const;
+    String* key() const;
+    void key(String* key);
 
 private:
-    std::string m_name;
+    std::string_view m_name;
+    // Interned name, set by the resolver when the identifier names a property.
+    String* m_key { nullptr };
+    uint32_t m_depth { Unresolved };
+    uint32_t m_slot { Unresolved };
 };
 
 class FunctionExpression final : public Expression {
 public:
-    explicit FunctionExpression(std::vector<Identifier*> m_params,
+    explicit FunctionExpression(AstList<Identifier*> m_params,
         BlockStatement* m_body);
-    ~FunctionExpression();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
-    const std::vector<Identifier*>& params() const;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
+    const AstList<Identifier*>& params() const;
 
 private:
-    std::vector<Identifier*> m_params;
+    AstList<Identifier*> m_params;
     BlockStatement* m_body;
+    size_t m_slotCount { 0 };
 };
 
 class ReturnStatement final : public Statement {
 public:
     explicit ReturnStatement(Expression* argument);
-    ~ReturnStatement();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Expression* m_argument;
@@ -166,10 +238,11 @@ private:
 
 class VariableDeclarator final : public Ast {
 public:
-    explicit VariableDeclarator(Identifier* name, Expression* init = new Literal(Value()));
-    ~VariableDeclarator();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    explicit VariableDeclarator(Identifier* name, Expression* init);
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
+    Identifier* name() const;
 
 private:
     Identifier* m_name;
@@ -178,33 +251,34 @@ private:
 
 class VariableDeclaration final : public Statement {
 public:
-    explicit VariableDeclaration(std::vector<VariableDeclarator*> declarators);
-    ~VariableDeclaration();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    explicit VariableDeclaration(AstList<VariableDeclarator*> declarators);
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
+    const AstList<VariableDeclarator*>& declarators() const;
 
 private:
-    std::vector<VariableDeclarator*> m_declarators;
+    AstList<VariableDeclarator*> m_declarators;
 };
 
 class CallExpression final : public Expression {
 public:
-    explicit CallExpression(Expression* name, std::vector<Expression*> arguments);
-    ~CallExpression();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    explicit CallExpression(Expression* name, AstList<Expression*> arguments);
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Expression* m_name;
-    std::vector<Expression*> m_arguments;
+    AstList<Expression*> m_arguments;
 };
 
 class PrintStatement final : public Statement {
 public:
     explicit PrintStatement(Expression* argument);
-    ~PrintStatement();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Expression* m_argument;
@@ -221,9 +295,9 @@ public:
         ModuloEquals
     };
     explicit AssignmentExpression(Operator op, Expression* left, Expression* right);
-    ~AssignmentExpression();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Operator m_op;
@@ -239,9 +313,9 @@ public:
     };
 
     explicit LogicalExpression(Operator op, Expression* left, Expression* right);
-    ~LogicalExpression();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Operator m_op;
@@ -254,9 +328,9 @@ public:
     explicit IfElseStatement(Expression* condition, Statement* ifBranch,
         Statement* elseBranch);
     IfElseStatement(Expression* condition, Statement* ifBranch);
-    ~IfElseStatement();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Expression* m_condition;
@@ -268,23 +342,24 @@ class ForLoopStatement final : public Statement {
 public:
     explicit ForLoopStatement(Statement* init, Expression* condition,
         Expression* increment, Statement* body);
-    ~ForLoopStatement();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Statement* m_init;
     Expression* m_condition;
     Expression* m_increment;
     Statement* m_body;
+    size_t m_slotCount { 0 };
 };
 
 class WhileLoopStatement final : public Statement {
 public:
     explicit WhileLoopStatement(Expression* condition, Statement* body);
-    ~WhileLoopStatement();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Expression* m_condition;
@@ -294,9 +369,9 @@ private:
 class DoWhileLoopStatement final : public Statement {
 public:
     explicit DoWhileLoopStatement(Expression* condition, Statement* body);
-    ~DoWhileLoopStatement();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Expression* m_condition;
@@ -306,62 +381,71 @@ private:
 class ObjectProperty final : public Ast {
 public:
     explicit ObjectProperty(Identifier* name, Expression* value);
-    ~ObjectProperty();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
     Identifier* name();
     Expression* value();
+    uint32_t offset() const;
+    void offset(uint32_t offset);
 
 private:
     Identifier* m_name;
     Expression* m_value;
+    uint32_t m_offset { 0 };
 };
 
 class ObjectExpression final : public Expression {
 public:
-    explicit ObjectExpression(std::vector<ObjectProperty*> properties);
-    ~ObjectExpression();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
-    const std::vector<ObjectProperty*>& properties() const;
+    explicit ObjectExpression(AstList<ObjectProperty*> properties);
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
+    const AstList<ObjectProperty*>& properties() const;
 
 private:
-    std::vector<ObjectProperty*> m_properties;
+    AstList<ObjectProperty*> m_properties;
+    // Shape of the finished literal, every evaluation starts out with it.
+    Shape* m_shape { nullptr };
 };
 
 class MemberExpression final : public Expression {
 public:
-    explicit MemberExpression(Expression* object, Identifier* property);
-    ~MemberExpression();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
-    virtual bool isMemberExpression() const override;
+    explicit MemberExpression(Expression* object, Identifier* property, size_t line = 0);
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
     Expression* object();
     Identifier* property();
+    const Identifier* property() const;
+    size_t line() const;
+    InlineCache& cache() const;
 
 private:
     Expression* m_object;
     Identifier* m_property;
+    size_t m_line;
+    // Shared by loads and stores through this expression, in both engines.
+    mutable InlineCache m_cache;
 };
 
 class ArrayExpression final : public Expression {
 public:
-    explicit ArrayExpression(std::vector<Expression*> elements);
-    ~ArrayExpression();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    explicit ArrayExpression(AstList<Expression*> elements);
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
-    std::vector<Expression*> m_elements;
+    AstList<Expression*> m_elements;
 };
 
 class ArrayMemberExpression final : public Expression {
 public:
     explicit ArrayMemberExpression(Expression* array, Expression* index);
-    ~ArrayMemberExpression();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
-    virtual bool isArrayMemberExpression() const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
     Expression* array() const;
     Expression* index() const;
 
@@ -373,17 +457,17 @@ private:
 class ContinueStatement final : public Statement {
 public:
     explicit ContinueStatement();
-    ~ContinueStatement();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 };
 
 class BreakStatement final : public Statement {
 public:
     explicit BreakStatement();
-    ~BreakStatement();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 };
 
 class UpdateExpression final : public Expression {
@@ -393,9 +477,9 @@ public:
         Decrement
     };
     explicit UpdateExpression(Operation op, bool prefix, Expression* argument);
-    ~UpdateExpression();
-    virtual std::optional<Value> execute(Interpreter& interpreter) const override;
-    virtual void prettyPrint(int32_t indentLevel) const override;
+    virtual uint32_t flatten(FlatAst& ast) const override;
+    virtual void compile(Compiler& compiler) const override;
+    virtual void resolve(Resolver& resolver) override;
 
 private:
     Operation m_op;
@@ -163,10 +163,6 @@ int main()
         interpreter.run(program);
     } catch (Msl::RuntimeException& e) {
         std::cout << "Runtime Error: " << e.message << std::endl;
-    } catch (Msl::BreakException& e) {
-        std::cout << "Runtime Error: break outside loop." << std::endl;
-    } catch (Msl::ContinueException& e) {
-        std::cout << "Runtime Error: continue outside loop." << std::endl;
     }
 
     delete program;
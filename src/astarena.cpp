@@ -0,0 +1,28 @@
+#include "astarena.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace Msl {
+
+std::string_view AstArena::string(std::string_view string)
+{
+    if (string.empty())
+        return {};
+    auto data = static_cast<char*>(allocate(string.size(), 1));
+    std::memcpy(data, string.data(), string.size());
+    return std::string_view(data, string.size());
+}
+
+void* AstArena::allocateSlowCase(size_t size)
+{
+    // Chunk starts are aligned for any node.
+    size_t capacity = std::max(ChunkSize, size);
+    m_chunks.emplace_back(new char[capacity]);
+    m_chunk = m_chunks.back().get();
+    m_used = size;
+    m_capacity = capacity;
+    return m_chunk;
+}
+
+}
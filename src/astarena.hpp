@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace Msl {
+
+// A fixed array of AST elements stored in an AstArena.
+template <typename T>
+class AstList {
+public:
+    AstList() = default;
+
+    AstList(const T* data, size_t size)
+        : m_data(data)
+        , m_size(size)
+    {
+    }
+
+    const T* begin() const { return m_data; }
+    const T* end() const { return m_data + m_size; }
+    size_t size() const { return m_size; }
+    bool empty() const { return !m_size; }
+    const T& operator[](size_t i) const
+    {
+        assert(i < m_size);
+        return m_data[i];
+    }
+
+private:
+    const T* m_data { nullptr };
+    size_t m_size { 0 };
+};
+
+// Bump allocator holding every node of one parse. Nodes are never destroyed
+// one by one, they have to be trivially destructible and go away when the
+// arena frees its chunks.
+class AstArena {
+public:
+    AstArena() = default;
+    AstArena(const AstArena&) = delete;
+    AstArena& operator=(const AstArena&) = delete;
+
+    template <typename T, typename... Args>
+    T* make(Args&&... args)
+    {
+        static_assert(std::is_trivially_destructible_v<T>, "AST nodes are freed with their arena, without running destructors");
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    template <typename T>
+    AstList<T> list(const std::vector<T>& elements)
+    {
+        static_assert(std::is_trivially_copyable_v<T>, "AstList elements are copied into the arena");
+        if (elements.empty())
+            return {};
+        auto data = static_cast<T*>(allocate(sizeof(T) * elements.size(), alignof(T)));
+        std::uninitialized_copy(elements.begin(), elements.end(), data);
+        return AstList<T>(data, elements.size());
+    }
+
+    std::string_view string(std::string_view string);
+
+private:
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+    void* allocate(size_t size, size_t alignment)
+    {
+        assert(alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+        size_t offset = (m_used + alignment - 1) & ~(alignment - 1);
+        if (offset + size > m_capacity)
+            return allocateSlowCase(size);
+        m_used = offset + size;
+        return m_chunk + offset;
+    }
+
+    void* allocateSlowCase(size_t size);
+
+    std::vector<std::unique_ptr<char[]>> m_chunks;
+    char* m_chunk { nullptr };
+    size_t m_used { 0 };
+    size_t m_capacity { 0 };
+};
+
+}
@@ -0,0 +1,84 @@
+#include "block.hpp"
+#include "cell.hpp"
+#include "heap.hpp"
+#include "heapstatistics.hpp"
+
+namespace Msl {
+
+Block::Block(Heap* heap, size_t cellSize)
+    : m_heap(heap)
+    , m_cellSize(cellSize)
+    , m_reciprocal(((uint64_t(1) << 32) + cellSize - 1) / cellSize)
+{
+    size_t header = (sizeof(Block) + cellSize - 1) / cellSize * cellSize;
+    m_cells = reinterpret_cast<char*>(this) + header;
+    m_cursor = m_cells;
+    m_end = reinterpret_cast<char*>(this) + Size;
+    for (auto& word : m_markBits) {
+        word.store(0, std::memory_order_relaxed);
+    }
+    for (auto& word : m_allocatedBits) {
+        word = 0;
+    }
+}
+
+void Block::free(Cell* cell)
+{
+    size_t i = index(cell);
+    m_allocatedBits[i / 64] &= ~bit(i);
+    m_liveCells--;
+    auto freeCell = reinterpret_cast<FreeCell*>(cell);
+    freeCell->next = m_freeList;
+    m_freeList = freeCell;
+}
+
+void Block::forward(Cell* cell, Cell* address)
+{
+    free(cell);
+    reinterpret_cast<FreeCell*>(cell)->forwardingAddress = address;
+}
+
+size_t Block::markedCells() const
+{
+    size_t count = 0;
+    for (auto& word : m_markBits) {
+        count += __builtin_popcountll(word.load(std::memory_order_relaxed));
+    }
+    return count;
+}
+
+size_t Block::sweep(HeapStatistics& statistics)
+{
+    size_t liveCells = m_liveCells;
+    for (size_t word = 0; word < MaxCells / 64; ++word) {
+        uint64_t marks = m_markBits[word].load(std::memory_order_relaxed);
+        uint64_t dead = m_allocatedBits[word] & ~marks;
+        while (dead) {
+            size_t i = word * 64 + __builtin_ctzll(dead);
+            dead &= dead - 1;
+            Cell* cell = cellAt(i);
+            statistics.freed(cell->cellType(), m_cellSize);
+            m_heap->payloadFreed(cell->payloadSize());
+            cell->~Cell();
+            auto freeCell = reinterpret_cast<FreeCell*>(cell);
+            freeCell->next = m_freeList;
+            m_freeList = freeCell;
+            m_liveCells--;
+        }
+        m_allocatedBits[word] &= marks;
+        m_markBits[word].store(0, std::memory_order_relaxed);
+    }
+    m_swept = true;
+    return liveCells - m_liveCells;
+}
+
+void Block::destroyCells()
+{
+    forEachCell([](Cell* cell) { cell->~Cell(); });
+    for (auto& word : m_allocatedBits) {
+        word = 0;
+    }
+    m_liveCells = 0;
+}
+
+}
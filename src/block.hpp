@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace Msl {
+
+class Cell;
+class Heap;
+struct HeapStatistics;
+
+// A page of the heap holding cells of a single size class. Pages are
+// aligned to their size, so a cell finds its page by masking its own
+// address. Which slots hold a cell and which cells are marked is kept in
+// bitmaps here, dead slots are threaded on the page's free list.
+class Block {
+public:
+    static constexpr size_t Size = 64 * 1024;
+    static constexpr size_t CellAlignment = 16;
+
+    static Block* of(const void* cell)
+    {
+        return reinterpret_cast<Block*>(reinterpret_cast<uintptr_t>(cell) & ~(Size - 1));
+    }
+
+    // Constructed in place at the start of Size aligned memory.
+    Block(Heap* heap, size_t cellSize);
+
+    Heap* heap() const { return m_heap; }
+    size_t cellSize() const { return m_cellSize; }
+    size_t liveCells() const { return m_liveCells; }
+    size_t cellCount() const { return (m_end - m_cells) / m_cellSize; }
+    bool hasFreeCell() const { return m_freeList || m_cursor + m_cellSize <= m_end; }
+    // A full collection leaves its blocks unswept, the dead cells in them
+    // are only destroyed once the block is needed.
+    bool swept() const { return m_swept; }
+    void swept(bool swept) { m_swept = swept; }
+    size_t markedCells() const;
+    // Set while a compaction moves cells out of the block.
+    bool evacuating() const { return m_evacuating; }
+    void evacuating(bool evacuating) { m_evacuating = evacuating; }
+
+    // Pops the free list, or bumps into the never used tail of the page.
+    // Returns null when the page is full.
+    void* allocate()
+    {
+        char* cell;
+        if (m_freeList) {
+            cell = reinterpret_cast<char*>(m_freeList);
+            m_freeList = m_freeList->next;
+        } else if (m_cursor + m_cellSize <= m_end) {
+            cell = m_cursor;
+            m_cursor += m_cellSize;
+        } else {
+            return nullptr;
+        }
+        size_t i = index(cell);
+        m_allocatedBits[i / 64] |= bit(i);
+        m_liveCells++;
+        return cell;
+    }
+
+    // Puts the slot of a destroyed cell back on the free list.
+    void free(Cell* cell);
+    // Frees the slot of a cell that was moved to another address, which is
+    // left in the slot until the slot is reused.
+    void forward(Cell* cell, Cell* address);
+    Cell* forwardingAddress(const Cell* cell) const
+    {
+        return reinterpret_cast<const FreeCell*>(cell)->forwardingAddress;
+    }
+
+    bool allocated(const Cell* cell) const
+    {
+        size_t i = index(cell);
+        return m_allocatedBits[i / 64] & bit(i);
+    }
+
+    template <typename Visitor>
+    void forEachCell(Visitor&& visit)
+    {
+        for (size_t word = 0; word < MaxCells / 64; ++word) {
+            uint64_t allocated = m_allocatedBits[word];
+            while (allocated) {
+                size_t i = word * 64 + __builtin_ctzll(allocated);
+                allocated &= allocated - 1;
+                visit(cellAt(i));
+            }
+        }
+    }
+
+    bool marked(const Cell* cell) const
+    {
+        size_t i = index(cell);
+        return m_markBits[i / 64].load(std::memory_order_relaxed) & bit(i);
+    }
+
+    void marked(const Cell* cell, bool marked)
+    {
+        size_t i = index(cell);
+        if (marked) {
+            m_markBits[i / 64].fetch_or(bit(i), std::memory_order_relaxed);
+        } else {
+            m_markBits[i / 64].fetch_and(~bit(i), std::memory_order_relaxed);
+        }
+    }
+
+    bool tryMark(const Cell* cell)
+    {
+        size_t i = index(cell);
+        return !(m_markBits[i / 64].fetch_or(bit(i), std::memory_order_relaxed) & bit(i));
+    }
+
+    // Destroys every allocated cell that is not marked, counting it as freed,
+    // and clears the mark bitmap. Returns the number of cells destroyed.
+    size_t sweep(HeapStatistics& statistics);
+    // Destroys every allocated cell, used when the heap goes away.
+    void destroyCells();
+
+private:
+    static constexpr size_t MaxCells = Size / CellAlignment;
+
+    // Overlays a dead slot, slots are at least CellAlignment bytes.
+    struct FreeCell {
+        FreeCell* next;
+        Cell* forwardingAddress;
+    };
+
+    static uint64_t bit(size_t i)
+    {
+        return uint64_t(1) << (i % 64);
+    }
+
+    // Cells start at multiples of the cell size, so multiplying by the
+    // rounded up reciprocal divides exactly without a division instruction.
+    size_t index(const void* cell) const
+    {
+        uint64_t offset = static_cast<const char*>(cell) - m_cells;
+        return (offset * m_reciprocal) >> 32;
+    }
+
+    Cell* cellAt(size_t i) const
+    {
+        return reinterpret_cast<Cell*>(m_cells + i * m_cellSize);
+    }
+
+    Heap* m_heap;
+    uint32_t m_cellSize;
+    uint32_t m_reciprocal;
+    size_t m_liveCells { 0 };
+    bool m_swept { true };
+    bool m_evacuating { false };
+    char* m_cells;
+    char* m_cursor;
+    char* m_end;
+    FreeCell* m_freeList { nullptr };
+    std::atomic<uint64_t> m_markBits[MaxCells / 64];
+    uint64_t m_allocatedBits[MaxCells / 64];
+};
+
+}
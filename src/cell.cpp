@@ -0,0 +1,67 @@
+#include "cell.hpp"
+#include "heap.hpp"
+
+#include <mutex>
+
+namespace Msl {
+
+std::atomic<unsigned> Cell::s_markingHeaps { 0 };
+
+Cell::Cell()
+{
+}
+
+Cell::~Cell()
+{
+}
+
+void Cell::trace(Visitor&)
+{
+}
+
+size_t Cell::payloadSize() const
+{
+    return 0;
+}
+
+void Cell::payloadGrown(size_t bytes)
+{
+    Block::of(this)->heap()->payloadAllocated(bytes);
+}
+
+void Cell::writeBarrierSlowCase(Cell* target)
+{
+    Heap* heap = Block::of(this)->heap();
+    if (m_old && !m_remembered && !target->old()) {
+        heap->remember(this);
+    }
+    if (s_markingHeaps.load(std::memory_order_relaxed) && marked() && !target->marked()) {
+        heap->shade(target);
+    }
+}
+
+// Snapshot at the beginning: the value being overwritten was reachable when
+// marking started, so it is handed to the marker before it disappears.
+void Cell::writeConcurrently(Value& field, Value value)
+{
+    Heap* heap = Block::of(this)->heap();
+    if (!heap->markingConcurrently()) {
+        field = value;
+        return;
+    }
+    std::lock_guard<Cell> guard(*this);
+    heap->logOverwritten(field);
+    field = value;
+}
+
+void Cell::appendConcurrently(std::vector<Value>& fields, Value value)
+{
+    if (!Block::of(this)->heap()->markingConcurrently()) {
+        fields.push_back(value);
+        return;
+    }
+    std::lock_guard<Cell> guard(*this);
+    fields.push_back(value);
+}
+
+}
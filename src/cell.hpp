@@ -0,0 +1,128 @@
+#pragma once
+
+#include "block.hpp"
+#include "value.hpp"
+
+#include <atomic>
+#include <vector>
+
+namespace Msl {
+
+class Cell;
+
+// Dynamic type of a cell as counted by HeapStatistics.
+enum class CellType : uint8_t {
+    Object,
+    Array,
+    Function,
+    String,
+    Environment
+};
+
+constexpr size_t CellTypeCount = 5;
+
+// Receives the references held by a cell, see Cell::trace().
+class Visitor {
+public:
+    virtual ~Visitor() = default;
+    virtual void visit(Cell* cell) = 0;
+    // Called for fields holding values, a visitor that moves cells rewrites
+    // them in place.
+    virtual void visit(Value& value)
+    {
+        if (value.isCell()) {
+            visit(value.cell());
+        }
+    }
+};
+
+// Base class of everything that lives on the garbage collected heap.
+class Cell {
+public:
+    Cell();
+    virtual ~Cell();
+    // Hands every cell this one references to the visitor. Cell types with
+    // references override it, the collector knows no other way to find them.
+    virtual void trace(Visitor& visitor);
+    // Bytes the cell occupies on the heap, at most its block's cell size.
+    virtual size_t cellSize() const = 0;
+    // Bytes the cell owns outside its block, such as string text or vector
+    // storage. The heap charges them to its limit while the cell is alive.
+    virtual size_t payloadSize() const;
+    virtual CellType cellType() const = 0;
+    // Mark bits live in the bitmap of the cell's block, see block.hpp.
+    bool marked() const { return Block::of(this)->marked(this); }
+    void marked(bool marked) { Block::of(this)->marked(this, marked); }
+    // Sets the mark bit, returns false if another marker thread got there first.
+    bool tryMark() { return Block::of(this)->tryMark(this); }
+
+    // Cells that survived a minor collection belong to the old generation.
+    bool old() const { return m_old; }
+    void old(bool old) { m_old = old; }
+    bool remembered() const { return m_remembered; }
+    void remembered(bool remembered) { m_remembered = remembered; }
+
+    // Held by the concurrent marker while it traces the cell and by the
+    // mutator while it writes to it during concurrent marking.
+    void lock()
+    {
+        while (m_locked.exchange(true, std::memory_order_acquire)) {
+        }
+    }
+    void unlock() { m_locked.store(false, std::memory_order_release); }
+
+    // Number of heaps currently in a marking cycle, while it is zero stores
+    // into cells need neither the lock, the snapshot barrier nor a look at
+    // the mark bit.
+    static std::atomic<unsigned> s_markingHeaps;
+
+protected:
+    // Every store of a value into a field of a cell goes through write() or
+    // append() so that the collector's barriers see it.
+    void write(Value& field, Value value)
+    {
+        writeBarrier(value);
+        if (s_markingHeaps.load(std::memory_order_relaxed)) {
+            writeConcurrently(field, value);
+        } else {
+            field = value;
+        }
+    }
+
+    void append(std::vector<Value>& fields, Value value)
+    {
+        writeBarrier(value);
+        size_t capacity = fields.capacity();
+        if (s_markingHeaps.load(std::memory_order_relaxed)) {
+            appendConcurrently(fields, value);
+        } else {
+            fields.push_back(value);
+        }
+        if (fields.capacity() != capacity) {
+            payloadGrown((fields.capacity() - capacity) * sizeof(Value));
+        }
+    }
+
+private:
+    // Records old cells that start pointing at young ones so minor
+    // collections can find them, and while an incremental collection is
+    // marking shades the values stored into marked cells.
+    void writeBarrier(Value value)
+    {
+        bool marking = s_markingHeaps.load(std::memory_order_relaxed);
+        if (value.isCell() && ((m_old && !m_remembered) || marking)) {
+            writeBarrierSlowCase(value.cell());
+        }
+    }
+
+    void writeBarrierSlowCase(Cell* target);
+    void payloadGrown(size_t bytes);
+    void writeConcurrently(Value& field, Value value);
+    void appendConcurrently(std::vector<Value>& fields, Value value);
+
+    std::atomic<bool> m_locked { false };
+    bool m_old { false };
+    bool m_remembered { false };
+};
+
+}
@@ -0,0 +1,137 @@
+#include "chunk.hpp"
+#include "exceptions.hpp"
+
+#include <limits>
+
+namespace Msl {
+
+FunctionPrototype::FunctionPrototype(std::vector<std::string> params, size_t slotCount)
+    : m_params(std::move(params))
+    , m_slotCount(slotCount)
+    , m_chunk(std::make_unique<Chunk>())
+{
+}
+
+const std::vector<std::string>& FunctionPrototype::params() const
+{
+    return m_params;
+}
+
+size_t FunctionPrototype::slotCount() const
+{
+    return m_slotCount;
+}
+
+Chunk& FunctionPrototype::chunk() const
+{
+    return *m_chunk;
+}
+
+size_t Chunk::write(uint8_t byte)
+{
+    m_code.push_back(byte);
+    return m_code.size() - 1;
+}
+
+void Chunk::patch(size_t offset, uint8_t byte)
+{
+    m_code[offset] = byte;
+}
+
+size_t Chunk::size() const
+{
+    return m_code.size();
+}
+
+uint16_t Chunk::addConstant(Value value)
+{
+    for (size_t i = 0; i < m_constants.size(); ++i) {
+        if (m_constants[i].isString() && value.isString()
+            && m_constants[i].string() == value.string()) {
+            return i;
+        }
+    }
+    if (m_constants.size() > std::numeric_limits<uint16_t>::max()) {
+        throw RuntimeException("Too many constants in one function");
+    }
+    m_constants.push_back(value);
+    return m_constants.size() - 1;
+}
+
+uint16_t Chunk::addName(std::string_view name)
+{
+    for (size_t i = 0; i < m_names.size(); ++i) {
+        if (m_names[i] == name) {
+            return i;
+        }
+    }
+    if (m_names.size() > std::numeric_limits<uint16_t>::max()) {
+        throw RuntimeException("Too many names in one function");
+    }
+    m_names.emplace_back(name);
+    return m_names.size() - 1;
+}
+
+uint16_t Chunk::addFunction(std::vector<std::string> params, size_t slotCount)
+{
+    if (m_functions.size() > std::numeric_limits<uint16_t>::max()) {
+        throw RuntimeException("Too many functions in one function");
+    }
+    m_functions.emplace_back(std::move(params), slotCount);
+    return m_functions.size() - 1;
+}
+
+uint16_t Chunk::addShape(Shape* shape)
+{
+    for (size_t i = 0; i < m_shapes.size(); ++i) {
+        if (m_shapes[i] == shape) {
+            return i;
+        }
+    }
+    if (m_shapes.size() > std::numeric_limits<uint16_t>::max()) {
+        throw RuntimeException("Too many object literals in one function");
+    }
+    m_shapes.push_back(shape);
+    return m_shapes.size() - 1;
+}
+
+uint16_t Chunk::addInlineCache(InlineCache* cache)
+{
+    if (m_inlineCaches.size() > std::numeric_limits<uint16_t>::max()) {
+        throw RuntimeException("Too many property accesses in one function");
+    }
+    m_inlineCaches.push_back(cache);
+    return m_inlineCaches.size() - 1;
+}
+
+const std::vector<uint8_t>& Chunk::code() const
+{
+    return m_code;
+}
+
+const std::vector<Value>& Chunk::constants() const
+{
+    return m_constants;
+}
+
+const std::vector<std::string>& Chunk::names() const
+{
+    return m_names;
+}
+
+const std::vector<FunctionPrototype>& Chunk::functions() const
+{
+    return m_functions;
+}
+
+const std::vector<Shape*>& Chunk::shapes() const
+{
+    return m_shapes;
+}
+
+const std::vector<InlineCache*>& Chunk::inlineCaches() const
+{
+    return m_inlineCaches;
+}
+
+}
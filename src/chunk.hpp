@@ -0,0 +1,117 @@
+#pragma once
+
+#include "value.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace Msl {
+
+enum class OpCode : uint8_t {
+    Constant,
+    Null,
+    True,
+    False,
+    Pop,
+
+    Add,
+    Subtract,
+    Multiply,
+    Divide,
+    Modulo,
+    Equal,
+    NotEqual,
+    Greater,
+    Less,
+    GreaterEqual,
+    LessEqual,
+    Not,
+    Negate,
+    Plus,
+
+    GetVariable,
+    DeclareVariable,
+    Undefined,
+    AssignVariable,
+    UpdateVariable,
+
+    GetProperty,
+    InitProperty,
+    AssignProperty,
+    UpdateProperty,
+
+    GetElement,
+    AssignElement,
+    UpdateElement,
+
+    NewObject,
+    NewArray,
+    MakeFunction,
+
+    PushScope,
+    PopScope,
+
+    Jump,
+    JumpIfFalse,
+    JumpIfFalseOrPop,
+    JumpIfTrueOrPop,
+    Loop,
+
+    Call,
+    Return,
+    Print
+};
+
+// Operand of the Update* instructions.
+enum UpdateFlags : uint8_t {
+    UpdateIncrement = 1 << 0,
+    UpdatePrefix = 1 << 1
+};
+
+class Chunk;
+
+class FunctionPrototype {
+public:
+    FunctionPrototype(std::vector<std::string> params, size_t slotCount);
+    const std::vector<std::string>& params() const;
+    size_t slotCount() const;
+    Chunk& chunk() const;
+
+private:
+    std::vector<std::string> m_params;
+    size_t m_slotCount;
+    std::unique_ptr<Chunk> m_chunk;
+};
+
+class Chunk {
+public:
+    size_t write(uint8_t byte);
+    void patch(size_t offset, uint8_t byte);
+    size_t size() const;
+    uint16_t addConstant(Value value);
+    uint16_t addName(std::string_view name);
+    uint16_t addFunction(std::vector<std::string> params, size_t slotCount);
+    uint16_t addShape(Shape* shape);
+    uint16_t addInlineCache(InlineCache* cache);
+
+    const std::vector<uint8_t>& code() const;
+    const std::vector<Value>& constants() const;
+    const std::vector<std::string>& names() const;
+    const std::vector<FunctionPrototype>& functions() const;
+    const std::vector<Shape*>& shapes() const;
+    const std::vector<InlineCache*>& inlineCaches() const;
+
+private:
+    std::vector<uint8_t> m_code;
+    std::vector<Value> m_constants;
+    std::vector<std::string> m_names;
+    std::vector<FunctionPrototype> m_functions;
+    std::vector<Shape*> m_shapes;
+    // Owned by the MemberExpression each property instruction came from.
+    std::vector<InlineCache*> m_inlineCaches;
+};
+
+}
@@ -0,0 +1,225 @@
+#include "compiler.hpp"
+#include "exceptions.hpp"
+
+#include <cassert>
+#include <limits>
+
+namespace Msl {
+
+Compiler::Compiler()
+{
+}
+
+std::unique_ptr<Chunk> Compiler::compile(const Program* program)
+{
+    auto chunk = std::make_unique<Chunk>();
+    m_chunk = chunk.get();
+    m_scopeDepth = 0;
+    m_loops.clear();
+
+    program->compile(*this);
+    emit(OpCode::Null);
+    emit(OpCode::Return);
+
+    m_chunk = nullptr;
+    return chunk;
+}
+
+void Compiler::emit(OpCode op)
+{
+    m_chunk->write(static_cast<uint8_t>(op));
+}
+
+void Compiler::emitByte(uint8_t byte)
+{
+    m_chunk->write(byte);
+}
+
+void Compiler::emitShort(uint16_t value)
+{
+    m_chunk->write(value & 0xff);
+    m_chunk->write(value >> 8);
+}
+
+void Compiler::emitConstant(Value value)
+{
+    if (value.isNull()) {
+        emit(OpCode::Null);
+    } else if (value.isBoolean()) {
+        emit(value.boolean() ? OpCode::True : OpCode::False);
+    } else {
+        emit(OpCode::Constant);
+        emitShort(m_chunk->addConstant(value));
+    }
+}
+
+void Compiler::emitName(OpCode op, std::string_view name)
+{
+    emit(op);
+    emitShort(m_chunk->addName(name));
+}
+
+void Compiler::emitProperty(OpCode op, const MemberExpression* member)
+{
+    emit(op);
+    emitShort(m_chunk->addConstant(Value(member->property()->key())));
+    emitShort(m_chunk->addInlineCache(&member->cache()));
+}
+
+void Compiler::emitShape(Shape* shape)
+{
+    emit(OpCode::NewObject);
+    emitShort(m_chunk->addShape(shape));
+}
+
+void Compiler::emitVariable(OpCode op, const Identifier* identifier)
+{
+    if (!identifier->resolved()) {
+        emitName(OpCode::Undefined, identifier->name());
+        return;
+    }
+    if (identifier->depth() > std::numeric_limits<uint8_t>::max()
+        || identifier->slot() > std::numeric_limits<uint16_t>::max()) {
+        throw RuntimeException("Too many nested scopes or variables");
+    }
+    emit(op);
+    emitByte(identifier->depth());
+    emitShort(identifier->slot());
+}
+
+void Compiler::emitFunction(BlockStatement* body, std::vector<std::string> params,
+    size_t slotCount)
+{
+    uint16_t index = m_chunk->addFunction(std::move(params), slotCount);
+
+    Chunk* enclosing = m_chunk;
+    size_t enclosingDepth = m_scopeDepth;
+    std::vector<Loop> enclosingLoops = std::move(m_loops);
+
+    m_chunk = &enclosing->functions()[index].chunk();
+    m_scopeDepth = 0;
+    m_loops.clear();
+
+    body->compileBody(*this);
+    emit(OpCode::Null);
+    emit(OpCode::Return);
+
+    m_chunk = enclosing;
+    m_scopeDepth = enclosingDepth;
+    m_loops = std::move(enclosingLoops);
+
+    emit(OpCode::MakeFunction);
+    emitShort(index);
+}
+
+size_t Compiler::emitJump(OpCode op)
+{
+    emit(op);
+    size_t offset = m_chunk->write(0xff);
+    m_chunk->write(0xff);
+    return offset;
+}
+
+void Compiler::patchJump(size_t offset)
+{
+    size_t distance = m_chunk->size() - offset - 2;
+    if (distance > std::numeric_limits<uint16_t>::max()) {
+        throw RuntimeException("Too much code to jump over");
+    }
+    m_chunk->patch(offset, distance & 0xff);
+    m_chunk->patch(offset + 1, distance >> 8);
+}
+
+void Compiler::emitLoop(size_t start)
+{
+    emit(OpCode::Loop);
+    size_t distance = m_chunk->size() - start + 2;
+    if (distance > std::numeric_limits<uint16_t>::max()) {
+        throw RuntimeException("Loop body too large");
+    }
+    emitShort(distance);
+}
+
+size_t Compiler::currentOffset() const
+{
+    return m_chunk->size();
+}
+
+void Compiler::beginScope(size_t slotCount)
+{
+    if (!slotCount)
+        return;
+    if (slotCount > std::numeric_limits<uint16_t>::max()) {
+        throw RuntimeException("Too many variables in one scope");
+    }
+    m_scopeDepth++;
+    emit(OpCode::PushScope);
+    emitShort(slotCount);
+}
+
+void Compiler::endScope(size_t slotCount)
+{
+    if (!slotCount)
+        return;
+    assert(m_scopeDepth > 0);
+    m_scopeDepth--;
+    emit(OpCode::PopScope);
+}
+
+void Compiler::beginLoop()
+{
+    m_loops.push_back({ m_scopeDepth, false, 0, {}, {} });
+}
+
+void Compiler::setContinueTarget(size_t offset)
+{
+    m_loops.back().hasContinueTarget = true;
+    m_loops.back().continueTarget = offset;
+}
+
+void Compiler::patchContinues()
+{
+    for (auto jump : m_loops.back().continues) {
+        patchJump(jump);
+    }
+    m_loops.back().continues.clear();
+}
+
+void Compiler::endLoop()
+{
+    for (auto jump : m_loops.back().breaks) {
+        patchJump(jump);
+    }
+    m_loops.pop_back();
+}
+
+void Compiler::emitBreak()
+{
+    if (m_loops.empty()) {
+        throw RuntimeException("'break' outside of a loop");
+    }
+    emitScopeExits(m_loops.back().scopeDepth);
+    m_loops.back().breaks.push_back(emitJump(OpCode::Jump));
+}
+
+void Compiler::emitContinue()
+{
+    if (m_loops.empty()) {
+        throw RuntimeException("'continue' outside of a loop");
+    }
+    emitScopeExits(m_loops.back().scopeDepth);
+    if (m_loops.back().hasContinueTarget) {
+        emitLoop(m_loops.back().continueTarget);
+    } else {
+        m_loops.back().continues.push_back(emitJump(OpCode::Jump));
+    }
+}
+
+void Compiler::emitScopeExits(size_t depth)
+{
+    for (size_t i = depth; i < m_scopeDepth; ++i) {
+        emit(OpCode::PopScope);
+    }
+}
+
+}
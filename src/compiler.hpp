@@ -0,0 +1,57 @@
+#pragma once
+
+#include "ast.hpp"
+#include "chunk.hpp"
+
+#include <memory>
+#include <vector>
+
+namespace Msl {
+
+class Compiler {
+public:
+    Compiler();
+    std::unique_ptr<Chunk> compile(const Program* program);
+
+    void emit(OpCode op);
+    void emitByte(uint8_t byte);
+    void emitShort(uint16_t value);
+    void emitConstant(Value value);
+    void emitName(OpCode op, std::string_view name);
+    void emitProperty(OpCode op, const MemberExpression* member);
+    void emitShape(Shape* shape);
+    void emitVariable(OpCode op, const Identifier* identifier);
+    void emitFunction(BlockStatement* body, std::vector<std::string> params,
+        size_t slotCount);
+    size_t emitJump(OpCode op);
+    void patchJump(size_t offset);
+    void emitLoop(size_t start);
+    size_t currentOffset() const;
+
+    void beginScope(size_t slotCount);
+    void endScope(size_t slotCount);
+
+    void beginLoop();
+    void setContinueTarget(size_t offset);
+    void patchContinues();
+    void endLoop();
+    void emitBreak();
+    void emitContinue();
+
+private:
+    struct Loop {
+        size_t scopeDepth;
+        bool hasContinueTarget;
+        size_t continueTarget;
+        std::vector<size_t> breaks;
+        std::vector<size_t> continues;
+    };
+
+    void emitScopeExits(size_t depth);
+
+    Chunk* m_chunk { nullptr };
+    size_t m_scopeDepth { 0 };
+    std::vector<Loop> m_loops;
+};
+
+}
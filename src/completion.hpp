@@ -0,0 +1,54 @@
+#pragma once
+
+#include "value.hpp"
+
+#include <cstdint>
+
+namespace Msl {
+
+// Result of executing an AST node. Expressions complete normally with their
+// value, statements that transfer control (return, break, continue) return
+// an abrupt completion that the enclosing loop or function consumes.
+class Completion {
+public:
+    enum class Type : uint8_t {
+        Normal,
+        Return,
+        Break,
+        Continue
+    };
+
+    Completion() = default;
+
+    Completion(Value value)
+        : m_value(value)
+    {
+    }
+
+    Completion(Type type, Value value = Value())
+        : m_type(type)
+        , m_value(value)
+    {
+    }
+
+    Type type() const
+    {
+        return m_type;
+    }
+
+    bool isAbrupt() const
+    {
+        return m_type != Type::Normal;
+    }
+
+    Value value() const
+    {
+        return m_value;
+    }
+
+private:
+    Type m_type { Type::Normal };
+    Value m_value;
+};
+
+}
@@ -0,0 +1,52 @@
+#include "environment.hpp"
+#include "exceptions.hpp"
+
+namespace Msl {
+
+Environment::Environment(Environment* parent, size_t size)
+    : m_parent(parent)
+    , m_slots(size, Value::uninitialized())
+{
+}
+
+void Environment::undefined()
+{
+    throw RuntimeException("Variable is undefined");
+}
+
+Environment* Environment::parent() const
+{
+    return m_parent;
+}
+
+const std::vector<Value>& Environment::slots() const
+{
+    return m_slots;
+}
+
+void Environment::trace(Visitor& visitor)
+{
+    for (auto& value : m_slots) {
+        visitor.visit(value);
+    }
+    if (m_parent) {
+        visitor.visit(m_parent);
+    }
+}
+
+size_t Environment::cellSize() const
+{
+    return sizeof(Environment);
+}
+
+size_t Environment::payloadSize() const
+{
+    return m_slots.capacity() * sizeof(Value);
+}
+
+CellType Environment::cellType() const
+{
+    return CellType::Environment;
+}
+
+}
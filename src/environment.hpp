@@ -0,0 +1,45 @@
+#pragma once
+
+#include "cell.hpp"
+#include "value.hpp"
+
+#include <vector>
+
+namespace Msl {
+
+// A materialized scope: the variables the resolver assigned to one scope,
+// stored in declaration order and addressed by slot.
+class Environment final : public Cell {
+public:
+    Environment(Environment* parent, size_t size);
+    Environment* parent() const;
+    const std::vector<Value>& slots() const;
+    virtual void trace(Visitor& visitor) override;
+    virtual size_t cellSize() const override;
+    virtual size_t payloadSize() const override;
+    virtual CellType cellType() const override;
+
+    // Reading a variable before its declaration ran is an error, as it
+    // was when scopes were looked up by name.
+    Value get(size_t slot) const
+    {
+        Value value = m_slots[slot];
+        if (value.isUninitialized()) {
+            undefined();
+        }
+        return value;
+    }
+
+    void set(size_t slot, Value value)
+    {
+        write(m_slots[slot], value);
+    }
+
+private:
+    [[noreturn]] static void undefined();
+
+    Environment* m_parent;
+    std::vector<Value> m_slots;
+};
+
+}
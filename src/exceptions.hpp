@@ -1,7 +1,6 @@
 #pragma once
 
 #include "token.hpp"
-#include "value.hpp"
 
 #include <exception>
 
@@ -31,21 +30,4 @@ public:
     std::string message;
 };
 
-class ReturnException : public Exception {
-public:
-    ReturnException(Value value)
-        : value(value)
-    {
-    }
-    Value value;
-};
-
-class BreakException : public Exception {
-public:
-};
-
-class ContinueException : public Exception {
-public:
-};
-
 }
@@ -0,0 +1,668 @@
+#include "flatast.hpp"
+
+#include "array.hpp"
+#include "environment.hpp"
+#include "exceptions.hpp"
+#include "function.hpp"
+#include "handle.hpp"
+#include "interpreter.hpp"
+
+#include <cassert>
+#include <iostream>
+
+namespace Msl {
+
+static_assert(sizeof(FlatAst::Node) == 16, "Nodes should stay small, four of them fill a cache line");
+
+FlatAst::FlatAst(const Program& program)
+{
+    m_root = program.flatten(*this);
+}
+
+FlatAst::Index FlatAst::add(Ast::Kind kind, uint8_t op, Index a, Index b, Index c)
+{
+    m_nodes.push_back({ kind, op, a, b, c });
+    return m_nodes.size() - 1;
+}
+
+FlatAst::Index FlatAst::addList(const std::vector<Index>& nodes)
+{
+    Index first = m_lists.size();
+    m_lists.insert(m_lists.end(), nodes.begin(), nodes.end());
+    return first;
+}
+
+FlatAst::Index FlatAst::addConstant(Value value)
+{
+    m_constants.push_back(value);
+    return m_constants.size() - 1;
+}
+
+FlatAst::Index FlatAst::addName(std::string_view name)
+{
+    m_names.push_back(name);
+    return m_names.size() - 1;
+}
+
+FlatAst::Index FlatAst::addShape(Shape* shape)
+{
+    m_shapes.push_back(shape);
+    return m_shapes.size() - 1;
+}
+
+FlatAst::Index FlatAst::addSite(String* key, InlineCache* cache)
+{
+    m_sites.push_back({ key, cache });
+    return m_sites.size() - 1;
+}
+
+void FlatAst::run(Interpreter& interpreter) const
+{
+    executeBody(interpreter, m_nodes[m_root]);
+}
+
+Value FlatAst::call(Interpreter& interpreter, Index body, Environment* environment) const
+{
+    interpreter.stack().push_back(environment);
+    interpreter.heap().safepoint();
+    Completion completion = executeBody(interpreter, m_nodes[body]);
+    interpreter.stack().pop_back();
+
+    return completion.value();
+}
+
+static Environment* environmentAt(Environment* environment, uint32_t depth)
+{
+    for (uint32_t i = 0; i < depth; ++i) {
+        environment = environment->parent();
+    }
+    return environment;
+}
+
+Value FlatAst::getVariable(Interpreter& interpreter, const Node& identifier) const
+{
+    if (identifier.b == Identifier::Unresolved) {
+        throw RuntimeException("Variable is undefined");
+    }
+
+    return environmentAt(interpreter.environment(), identifier.a)->get(identifier.b);
+}
+
+Value FlatAst::setVariable(Interpreter& interpreter, const Node& identifier, Value value) const
+{
+    if (identifier.b == Identifier::Unresolved) {
+        throw RuntimeException("Variable doesn't Exist");
+    }
+
+    environmentAt(interpreter.environment(), identifier.a)->set(identifier.b, value);
+    return value;
+}
+
+Completion FlatAst::executeBody(Interpreter& interpreter, const Node& scope) const
+{
+    for (Index i = scope.a; i < scope.a + scope.b; ++i) {
+        Completion completion = execute(interpreter, m_lists[i]);
+        if (completion.isAbrupt())
+            return completion;
+    }
+
+    return {};
+}
+
+Completion FlatAst::execute(Interpreter& interpreter, Index index) const
+{
+    const Node& node = m_nodes[index];
+    switch (node.kind) {
+    case Ast::Kind::ExpressionStatement:
+        evaluate(interpreter, node.a);
+        return {};
+    case Ast::Kind::BlockStatement: {
+        if (!node.c)
+            return executeBody(interpreter, node);
+        interpreter.stack().push_back(interpreter.heap().allocate<Environment>(
+            interpreter.environment(), node.c));
+        Completion completion = executeBody(interpreter, node);
+        interpreter.stack().pop_back();
+        return completion;
+    }
+    case Ast::Kind::VariableDeclaration:
+        for (Index i = node.a; i < node.a + node.b; ++i) {
+            const Node& declarator = m_nodes[m_lists[i]];
+            Value init = evaluate(interpreter, declarator.b);
+            setVariable(interpreter, m_nodes[declarator.a], init);
+        }
+        return {};
+    case Ast::Kind::IfElseStatement:
+        if (evaluate(interpreter, node.a).toBoolean())
+            return execute(interpreter, node.b);
+        if (node.c != NoNode)
+            return execute(interpreter, node.c);
+        return {};
+    case Ast::Kind::ForLoopStatement:
+        return executeFor(interpreter, node);
+    case Ast::Kind::WhileLoopStatement:
+        while (node.a != NoNode ? evaluate(interpreter, node.a).toBoolean() : true) {
+            Completion completion = execute(interpreter, node.b);
+            if (completion.type() == Completion::Type::Break)
+                break;
+            if (completion.type() == Completion::Type::Return)
+                return completion;
+            interpreter.heap().safepoint();
+        }
+        return {};
+    case Ast::Kind::DoWhileLoopStatement:
+        do {
+            Completion completion = execute(interpreter, node.b);
+            if (completion.type() == Completion::Type::Break)
+                break;
+            if (completion.type() == Completion::Type::Return)
+                return completion;
+            interpreter.heap().safepoint();
+        } while (node.a != NoNode ? evaluate(interpreter, node.a).toBoolean() : true);
+        return {};
+    case Ast::Kind::ReturnStatement:
+        return Completion(Completion::Type::Return,
+            node.a != NoNode ? evaluate(interpreter, node.a) : Value());
+    case Ast::Kind::PrintStatement:
+        std::cout << evaluate(interpreter, node.a) << std::endl;
+        return {};
+    case Ast::Kind::ContinueStatement:
+        return Completion(Completion::Type::Continue);
+    case Ast::Kind::BreakStatement:
+        return Completion(Completion::Type::Break);
+    default:
+        assert(false); // Only statements are executed
+        return {};
+    }
+}
+
+Completion FlatAst::executeFor(Interpreter& interpreter, const Node& node) const
+{
+    Index init = m_lists[node.a];
+    Index condition = m_lists[node.a + 1];
+    Index increment = m_lists[node.a + 2];
+    Index body = m_lists[node.a + 3];
+
+    if (node.b) {
+        interpreter.stack().push_back(interpreter.heap().allocate<Environment>(
+            interpreter.environment(), node.b));
+    }
+    Completion result;
+    if (init != NoNode)
+        execute(interpreter, init);
+    for (; condition != NoNode ? evaluate(interpreter, condition).toBoolean() : true;
+         increment != NoNode ? evaluate(interpreter, increment) : Value()) {
+        Completion completion = execute(interpreter, body);
+        if (completion.type() == Completion::Type::Break)
+            break;
+        if (completion.type() == Completion::Type::Return) {
+            result = completion;
+            break;
+        }
+        interpreter.heap().safepoint();
+    }
+    if (node.b)
+        interpreter.stack().pop_back();
+
+    return result;
+}
+
+Value FlatAst::evaluate(Interpreter& interpreter, Index index) const
+{
+    const Node& node = m_nodes[index];
+    switch (node.kind) {
+    case Ast::Kind::Literal:
+        return m_constants[node.a];
+    case Ast::Kind::Identifier:
+        return getVariable(interpreter, node);
+    case Ast::Kind::BinaryExpression: {
+        Value left = evaluate(interpreter, node.a);
+        Value right;
+        // Arithmetic on numbers is the hot path, only heap operands need a handle.
+        if (left.isCell()) {
+            HandleScope scope(interpreter.heap());
+            Handle rootedLeft(interpreter.heap(), left);
+            right = evaluate(interpreter, node.b);
+            left = rootedLeft.get();
+        } else {
+            right = evaluate(interpreter, node.b);
+        }
+        switch (static_cast<BinaryExpression::Operator>(node.op)) {
+        case BinaryExpression::Operator::Addition:
+            return left.add(interpreter.heap(), right);
+        case BinaryExpression::Operator::Subtraction:
+            return left - right;
+        case BinaryExpression::Operator::Multiplication:
+            return left * right;
+        case BinaryExpression::Operator::Division:
+            return left / right;
+        case BinaryExpression::Operator::Modulo:
+            return left % right;
+        case BinaryExpression::Operator::Equals:
+            return left == right;
+        case BinaryExpression::Operator::Inequals:
+            return left != right;
+        case BinaryExpression::Operator::GreaterThan:
+            return left > right;
+        case BinaryExpression::Operator::LessThan:
+            return left < right;
+        case BinaryExpression::Operator::GreaterThanEquals:
+            return left >= right;
+        case BinaryExpression::Operator::LessThanEquals:
+            return left <= right;
+        }
+        assert(false);
+        return {};
+    }
+    case Ast::Kind::UnaryExpression: {
+        Value right = evaluate(interpreter, node.a);
+        switch (static_cast<UnaryExpression::Operator>(node.op)) {
+        case UnaryExpression::Operator::Not:
+            return Value(!right.toBoolean());
+        case UnaryExpression::Operator::Plus:
+            return Value(right.toNumber());
+        case UnaryExpression::Operator::Minus:
+            return Value(-right.toNumber());
+        }
+        return {};
+    }
+    case Ast::Kind::LogicalExpression: {
+        Value left = evaluate(interpreter, node.a);
+        switch (static_cast<LogicalExpression::Operator>(node.op)) {
+        case LogicalExpression::Operator::And:
+            if (!left.toBoolean())
+                return left;
+            break;
+        case LogicalExpression::Operator::Or:
+            if (left.toBoolean())
+                return left;
+            break;
+        }
+        return evaluate(interpreter, node.b);
+    }
+    case Ast::Kind::CallExpression:
+        return evaluateCall(interpreter, node);
+    case Ast::Kind::AssignmentExpression:
+        return evaluateAssignment(interpreter, node);
+    case Ast::Kind::UpdateExpression:
+        return evaluateUpdate(interpreter, node);
+    case Ast::Kind::MemberExpression: {
+        Value object = evaluate(interpreter, node.a);
+        if (!object.isObject())
+            return Value();
+        const Site& site = m_sites[node.c];
+        return object.object()->get(site.key, *site.cache);
+    }
+    case Ast::Kind::ArrayMemberExpression: {
+        HandleScope scope(interpreter.heap());
+        Handle rootedValue(interpreter.heap(), evaluate(interpreter, node.a));
+        Value index = evaluate(interpreter, node.b);
+        Value value = rootedValue.get();
+        if (!value.isArray())
+            throw RuntimeException("ArrayMemeberExpression on a non array value");
+        if (!index.isNumber())
+            throw RuntimeException("Can't use non number index on array");
+        return value.array()->at(index.number());
+    }
+    case Ast::Kind::ObjectExpression: {
+        HandleScope scope(interpreter.heap());
+        Handle rootedObject(interpreter.heap(), Value(interpreter.heap().allocate<Object>(m_shapes[node.c])));
+        for (Index i = node.a; i < node.a + node.b; ++i) {
+            const Node& property = m_nodes[m_lists[i]];
+            Value value = evaluate(interpreter, property.b);
+            rootedObject.get().object()->slot(property.c, value);
+        }
+        return rootedObject.get();
+    }
+    case Ast::Kind::ArrayExpression: {
+        HandleScope scope(interpreter.heap());
+        Handle rootedArray(interpreter.heap(), Value(interpreter.heap().allocate<Array>()));
+        for (Index i = node.a; i < node.a + node.b; ++i) {
+            Value value = evaluate(interpreter, m_lists[i]);
+            rootedArray.get().array()->append(value);
+        }
+        return rootedArray.get();
+    }
+    case Ast::Kind::FunctionExpression: {
+        std::vector<std::string> params = {};
+        for (Index i = node.a; i < node.a + node.b; ++i) {
+            params.emplace_back(m_names[m_nodes[m_lists[i]].c]);
+        }
+
+        auto function = interpreter.heap().allocate<Msl::Function>(this, node.c, params,
+            m_nodes[node.c].c, interpreter.environment());
+        return Value(function);
+    }
+    default:
+        assert(false); // Only expressions are evaluated
+        return {};
+    }
+}
+
+Value FlatAst::evaluateCall(Interpreter& interpreter, const Node& node) const
+{
+    HandleScope scope(interpreter.heap());
+    Value function = evaluate(interpreter, node.a);
+    if (!function.isFunction()) {
+        throw RuntimeException("Trying to call a non function value");
+    }
+    if (!function.function()->variadic()
+        && function.function()->paramCount() != node.c) {
+        throw RuntimeException("Invalid number of parameters to function");
+    }
+    // The callee and its arguments stay rooted for the whole call, until the
+    // arguments are stored in the callee's environment. Compaction may move
+    // them while later arguments run, only the handles are kept up to date.
+    Handle rootedFunction(interpreter.heap(), function);
+    size_t firstArgument = interpreter.heap().handles().size();
+    for (Index i = node.b; i < node.b + node.c; ++i) {
+        Handle rootedArgument(interpreter.heap(), evaluate(interpreter, m_lists[i]));
+    }
+    std::vector<Value> args(interpreter.heap().handles().begin() + firstArgument,
+        interpreter.heap().handles().end());
+    return rootedFunction.get().function()->execute(interpreter, args);
+}
+
+static Value applyAssignment(Interpreter& interpreter, AssignmentExpression::Operator op,
+    Value old, Value value)
+{
+    switch (op) {
+    case AssignmentExpression::Operator::Equals:
+        return value;
+    case AssignmentExpression::Operator::PlusEquals:
+        return old.add(interpreter.heap(), value);
+    case AssignmentExpression::Operator::MinusEquals:
+        return old - value;
+    case AssignmentExpression::Operator::AsteriskEquals:
+        return old * value;
+    case AssignmentExpression::Operator::SlashEquals:
+        return old / value;
+    case AssignmentExpression::Operator::ModuloEquals:
+        return old % value;
+    }
+    assert(false);
+    return value;
+}
+
+Value FlatAst::evaluateAssignment(Interpreter& interpreter, const Node& node) const
+{
+    auto op = static_cast<AssignmentExpression::Operator>(node.op);
+    const Node& left = m_nodes[node.a];
+    Value value = evaluate(interpreter, node.b);
+
+    if (left.kind == Ast::Kind::Identifier) {
+        auto old = getVariable(interpreter, left);
+        return setVariable(interpreter, left, applyAssignment(interpreter, op, old, value));
+    }
+
+    HandleScope scope(interpreter.heap());
+    Handle rootedValue(interpreter.heap(), value);
+
+    if (left.kind == Ast::Kind::MemberExpression) {
+        Value object = evaluate(interpreter, left.a);
+        const Site& site = m_sites[left.c];
+        if (!object.isObject())
+            throw RuntimeException("Assignment left expresion is not an object");
+        Handle rootedObject(interpreter.heap(), object);
+        Object* obj = object.object();
+        value = rootedValue.get();
+        if (op != AssignmentExpression::Operator::Equals)
+            value = applyAssignment(interpreter, op, obj->get(site.key, *site.cache), value);
+        return obj->set(site.key, value, *site.cache);
+    }
+
+    if (left.kind == Ast::Kind::ArrayMemberExpression) {
+        Handle rootedArray(interpreter.heap(), evaluate(interpreter, left.a));
+        Value indexValue = evaluate(interpreter, left.b);
+        Value array = rootedArray.get();
+        value = rootedValue.get();
+        if (!array.isArray())
+            throw RuntimeException("Assignment left expression is not an array");
+        if (!indexValue.isNumber())
+            throw RuntimeException("Can't use non number to access array element");
+        Array* arr = array.array();
+        size_t index = indexValue.number();
+        Value result = applyAssignment(interpreter, op, arr->at(index), value);
+        return arr->at(index, result);
+    }
+
+    throw RuntimeException("Assignment left expression is not an identifier or object property or array");
+}
+
+Value FlatAst::evaluateUpdate(Interpreter& interpreter, const Node& node) const
+{
+    const Node& argument = m_nodes[node.a];
+    Value oldVal = evaluate(interpreter, node.a);
+    if (!oldVal.isNumber())
+        throw RuntimeException("Can't incremenet/decrement non numbre variables");
+    Value newVal = static_cast<UpdateExpression::Operation>(node.op) == UpdateExpression::Operation::Increment
+        ? oldVal.number() + 1
+        : oldVal.number() - 1;
+
+    if (argument.kind == Ast::Kind::Identifier) {
+        setVariable(interpreter, argument, newVal);
+    } else if (argument.kind == Ast::Kind::MemberExpression) {
+        Value object = evaluate(interpreter, argument.a);
+        const Site& site = m_sites[argument.c];
+        if (!object.isObject())
+            throw RuntimeException("Assignment left expresion is not an object");
+        Object* obj = object.object();
+        obj->set(site.key, newVal, *site.cache);
+    } else if (argument.kind == Ast::Kind::ArrayMemberExpression) {
+        HandleScope scope(interpreter.heap());
+        Handle rootedArray(interpreter.heap(), evaluate(interpreter, argument.a));
+        Value index = evaluate(interpreter, argument.b);
+        Value array = rootedArray.get();
+        if (!index.isNumber())
+            throw RuntimeException("Array index isn't a number");
+        if (!array.isArray())
+            throw RuntimeException("not an Array");
+        Array* arr = array.array();
+        arr->at(index.number(), newVal);
+    } else {
+        throw RuntimeException("Assignment left expression is not an object, array or identifier");
+    }
+
+    return node.b ? newVal : oldVal;
+}
+
+static void printIndentation(int32_t indentLevel)
+{
+    for (int32_t i = 0; i < indentLevel; ++i) {
+        std::cout << "  ";
+    }
+}
+
+static void printField(const char* name, int32_t indentLevel)
+{
+    printIndentation(indentLevel);
+    std::cout << "- " << name << ":" << std::endl;
+}
+
+void FlatAst::prettyPrint(int32_t indentLevel) const
+{
+    prettyPrint(m_root, indentLevel);
+}
+
+void FlatAst::prettyPrintList(Index first, Index count, int32_t indentLevel) const
+{
+    for (Index i = first; i < first + count; ++i) {
+        prettyPrint(m_lists[i], indentLevel);
+    }
+}
+
+void FlatAst::prettyPrint(Index index, int32_t indentLevel) const
+{
+    if (index == NoNode)
+        return;
+
+    const Node& node = m_nodes[index];
+    printIndentation(indentLevel);
+    switch (node.kind) {
+    case Ast::Kind::Program:
+    case Ast::Kind::BlockStatement:
+        std::cout << (node.kind == Ast::Kind::Program ? "Program:" : "Block:") << std::endl;
+        printField("body", indentLevel + 1);
+        prettyPrintList(node.a, node.b, indentLevel + 2);
+        break;
+    case Ast::Kind::ExpressionStatement:
+        std::cout << "ExpressionStatement:" << std::endl;
+        printField("expression", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        break;
+    case Ast::Kind::Literal:
+        std::cout << "Literal:" << std::endl;
+        printField("value", indentLevel + 1);
+        printIndentation(indentLevel + 2);
+        if (node.op)
+            std::cout << m_names[node.b] << std::endl;
+        else
+            std::cout << m_constants[node.a] << std::endl;
+        break;
+    case Ast::Kind::BinaryExpression:
+    case Ast::Kind::AssignmentExpression:
+    case Ast::Kind::LogicalExpression:
+        if (node.kind == Ast::Kind::BinaryExpression)
+            std::cout << "BinaryExpression:" << std::endl;
+        else if (node.kind == Ast::Kind::AssignmentExpression)
+            std::cout << "AssignmentExpression:" << std::endl;
+        else
+            std::cout << "LogicalExpression:" << std::endl;
+        printField("op", indentLevel + 1);
+        printIndentation(indentLevel + 2);
+        std::cout << static_cast<int>(node.op) << std::endl;
+        printField("left", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        printField("rigth", indentLevel + 1);
+        prettyPrint(node.b, indentLevel + 2);
+        break;
+    case Ast::Kind::UnaryExpression:
+        std::cout << "UnaryExpression:" << std::endl;
+        printField("op", indentLevel + 1);
+        printIndentation(indentLevel + 2);
+        std::cout << static_cast<int>(node.op) << std::endl;
+        printField("right", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        break;
+    case Ast::Kind::Identifier:
+        std::cout << "Identifier:" << std::endl;
+        printField("name", indentLevel + 1);
+        printIndentation(indentLevel + 2);
+        std::cout << m_names[node.c] << std::endl;
+        break;
+    case Ast::Kind::FunctionExpression:
+        std::cout << "FunctionExpression:" << std::endl;
+        printField("params", indentLevel + 1);
+        prettyPrintList(node.a, node.b, indentLevel + 2);
+        printField("body", indentLevel + 1);
+        prettyPrint(node.c, indentLevel + 2);
+        break;
+    case Ast::Kind::ReturnStatement:
+        std::cout << "ReturnStatement:" << std::endl;
+        printField("argument", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        break;
+    case Ast::Kind::VariableDeclarator:
+        std::cout << "VariableDeclarator:" << std::endl;
+        printField("name", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        printField("init", indentLevel + 1);
+        prettyPrint(node.b, indentLevel + 2);
+        break;
+    case Ast::Kind::VariableDeclaration:
+        std::cout << "VariableDeclaration:" << std::endl;
+        printField("declarations", indentLevel + 1);
+        prettyPrintList(node.a, node.b, indentLevel + 2);
+        break;
+    case Ast::Kind::CallExpression:
+        std::cout << "CallExpression:" << std::endl;
+        printField("name", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        printField("arguments", indentLevel + 1);
+        prettyPrintList(node.b, node.c, indentLevel + 2);
+        break;
+    case Ast::Kind::PrintStatement:
+        std::cout << "PrintStatement:" << std::endl;
+        printField("argument", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        break;
+    case Ast::Kind::IfElseStatement:
+        std::cout << "IfElseStatement:" << std::endl;
+        printField("condition", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        printField("ifBranch", indentLevel + 1);
+        prettyPrint(node.b, indentLevel + 2);
+        printField("elseBranch", indentLevel + 1);
+        prettyPrint(node.c, indentLevel + 2);
+        break;
+    case Ast::Kind::ForLoopStatement:
+        std::cout << "ForLoopStatement:" << std::endl;
+        printField("init", indentLevel + 1);
+        prettyPrint(m_lists[node.a], indentLevel + 2);
+        printField("condition", indentLevel + 1);
+        prettyPrint(m_lists[node.a + 1], indentLevel + 2);
+        printField("incremenet", indentLevel + 1);
+        prettyPrint(m_lists[node.a + 2], indentLevel + 2);
+        printField("body", indentLevel + 1);
+        prettyPrint(m_lists[node.a + 3], indentLevel + 2);
+        break;
+    case Ast::Kind::WhileLoopStatement:
+    case Ast::Kind::DoWhileLoopStatement:
+        std::cout << (node.kind == Ast::Kind::WhileLoopStatement ? "WhileLoopStatement:" : "DoWhileLoopStatement:") << std::endl;
+        printField("condition", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        printField("body", indentLevel + 1);
+        prettyPrint(node.b, indentLevel + 2);
+        break;
+    case Ast::Kind::ObjectProperty:
+        std::cout << "ObjectProperty:" << std::endl;
+        printField("name", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        printField("value", indentLevel + 1);
+        prettyPrint(node.b, indentLevel + 2);
+        break;
+    case Ast::Kind::ObjectExpression:
+        std::cout << "ObjectExpression:" << std::endl;
+        printField("properties", indentLevel + 1);
+        prettyPrintList(node.a, node.b, indentLevel + 2);
+        break;
+    case Ast::Kind::MemberExpression:
+        std::cout << "MemberExpression:" << std::endl;
+        printField("object", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        printField("property", indentLevel + 1);
+        prettyPrint(node.b, indentLevel + 2);
+        break;
+    case Ast::Kind::ArrayExpression:
+        std::cout << "ArrayExpression:" << std::endl;
+        printField("elements", indentLevel + 1);
+        prettyPrintList(node.a, node.b, indentLevel + 2);
+        break;
+    case Ast::Kind::ArrayMemberExpression:
+        std::cout << "ArrayMememebrExpression:" << std::endl;
+        printField("array", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        printField("index", indentLevel + 1);
+        prettyPrint(node.b, indentLevel + 2);
+        break;
+    case Ast::Kind::ContinueStatement:
+        std::cout << "ContinueExpression:" << std::endl;
+        break;
+    case Ast::Kind::BreakStatement:
+        std::cout << "BreakExpression:" << std::endl;
+        break;
+    case Ast::Kind::UpdateExpression:
+        std::cout << "UpdateExpression:" << std::endl;
+        printField("argument", indentLevel + 1);
+        prettyPrint(node.a, indentLevel + 2);
+        printField("operator", indentLevel + 1);
+        printIndentation(indentLevel + 2);
+        std::cout << static_cast<int>(node.op) << std::endl;
+        printField("prefix", indentLevel + 1);
+        printIndentation(indentLevel + 2);
+        std::cout << node.b << std::endl;
+        break;
+    }
+}
+
+}
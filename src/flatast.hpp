@@ -0,0 +1,101 @@
+#pragma once
+
+#include "ast.hpp"
+#include "completion.hpp"
+#include "value.hpp"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace Msl {
+
+// The resolved program in the form the tree-walking engine runs. Every node
+// is a fixed size record in one contiguous buffer, children are 32-bit
+// indices into it and evaluation switches on the node's kind. Variable length
+// children, constants, names and the like live in side tables the node
+// fields index into.
+//
+// Node fields per kind:
+//   Program, BlockStatement    a: statements, b: count, c: slot count
+//   ExpressionStatement        a: expression
+//   Literal                    op: is string, a: constant, b: string name
+//   BinaryExpression           op, a: left, b: right
+//   UnaryExpression            op, a: operand
+//   Identifier                 a: depth, b: slot, c: name
+//   FunctionExpression         a: params, b: param count, c: body
+//   ReturnStatement            a: argument
+//   VariableDeclarator         a: identifier, b: initializer
+//   VariableDeclaration        a: declarators, b: count
+//   CallExpression             a: callee, b: arguments, c: count
+//   PrintStatement             a: argument
+//   AssignmentExpression       op, a: target, b: value
+//   LogicalExpression          op, a: left, b: right
+//   IfElseStatement            a: condition, b: if branch, c: else branch
+//   ForLoopStatement           a: init, condition, increment and body, b: slot count
+//   WhileLoopStatement         a: condition, b: body
+//   DoWhileLoopStatement       a: condition, b: body
+//   ObjectProperty             a: identifier, b: value, c: slot offset
+//   ObjectExpression           a: properties, b: count, c: shape
+//   MemberExpression           a: object, b: identifier, c: property site
+//   ArrayExpression            a: elements, b: count
+//   ArrayMemberExpression      a: array, b: index
+//   UpdateExpression           op, a: target, b: is prefix
+//
+// A function's body block carries the slot count of the function's
+// environment. The inline caches stay in the Program's MemberExpressions, so
+// the Program has to outlive this.
+class FlatAst {
+public:
+    typedef uint32_t Index;
+    static constexpr Index NoNode = UINT32_MAX;
+
+    struct Node {
+        Ast::Kind kind;
+        uint8_t op;
+        Index a;
+        Index b;
+        Index c;
+    };
+
+    explicit FlatAst(const Program& program);
+
+    Index add(Ast::Kind kind, uint8_t op = 0, Index a = NoNode, Index b = NoNode, Index c = NoNode);
+    Index addList(const std::vector<Index>& nodes);
+    Index addConstant(Value value);
+    Index addName(std::string_view name);
+    Index addShape(Shape* shape);
+    Index addSite(String* key, InlineCache* cache);
+
+    void run(Interpreter& interpreter) const;
+    Value call(Interpreter& interpreter, Index body, Environment* environment) const;
+    void prettyPrint(int32_t indentLevel) const;
+
+private:
+    struct Site {
+        String* key;
+        InlineCache* cache;
+    };
+
+    Completion execute(Interpreter& interpreter, Index index) const;
+    Completion executeBody(Interpreter& interpreter, const Node& scope) const;
+    Completion executeFor(Interpreter& interpreter, const Node& node) const;
+    Value evaluate(Interpreter& interpreter, Index index) const;
+    Value evaluateCall(Interpreter& interpreter, const Node& node) const;
+    Value evaluateAssignment(Interpreter& interpreter, const Node& node) const;
+    Value evaluateUpdate(Interpreter& interpreter, const Node& node) const;
+    Value getVariable(Interpreter& interpreter, const Node& identifier) const;
+    Value setVariable(Interpreter& interpreter, const Node& identifier, Value value) const;
+    void prettyPrint(Index index, int32_t indentLevel) const;
+    void prettyPrintList(Index first, Index count, int32_t indentLevel) const;
+
+    std::vector<Node> m_nodes;
+    std::vector<Index> m_lists;
+    std::vector<Value> m_constants;
+    std::vector<std::string_view> m_names;
+    std::vector<Shape*> m_shapes;
+    std::vector<Site> m_sites;
+    Index m_root;
+};
+
+}
@@ -3,9 +3,18 @@
 namespace Msl {
 
 class Value;
+class Cell;
+class String;
+class Shape;
+class InlineCache;
+class MemberExpression;
+class Environment;
 class Object;
 class Interpreter;
 class Heap;
 class Function;
 class Array;
+class Compiler;
+class Resolver;
+class FlatAst;
 }
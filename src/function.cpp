@@ -1,38 +1,64 @@
 #include "function.hpp"
-#include "exceptions.hpp"
+#include "array.hpp"
+#include "environment.hpp"
+#include "handle.hpp"
 #include "interpreter.hpp"
+#include "string.hpp"
 
 #include <iostream>
 
 namespace Msl {
 
-Function::Function(BlockStatement* body, std::vector<std::string> params)
-    : m_variadic(false)
+Function::Function(const FlatAst* ast, FlatAst::Index body, std::vector<std::string> params,
+    size_t slotCount, Environment* closure)
+    : Object(nullptr)
+    , m_variadic(false)
     , m_params(params)
+    , m_ast(ast)
     , m_body(body)
+    , m_slotCount(slotCount)
+    , m_closure(closure)
 {
 }
 
-Value Function::execute(Interpreter& interpreter, std::vector<Value> arguments)
+Function::Function(std::vector<std::string> params, size_t slotCount, Environment* closure,
+    const Chunk* chunk)
+    : Object(nullptr)
+    , m_variadic(false)
+    , m_params(params)
+    , m_slotCount(slotCount)
+    , m_closure(closure)
+    , m_chunk(chunk)
 {
-    std::unordered_map<std::string, Value> environment = {};
+}
 
-    for (size_t i = 0; i < m_params.size(); ++i) {
-        environment.emplace(m_params[i], arguments[i]);
+Value Function::execute(Interpreter& interpreter, std::vector<Value> arguments)
+{
+    Environment* environment = m_closure;
+    if (m_slotCount) {
+        // The caller keeps this function and the arguments rooted.
+        environment = interpreter.heap().allocate<Environment>(m_closure, m_slotCount);
+        for (size_t i = 0; i < m_params.size(); ++i) {
+            environment->set(i, arguments[i]);
+        }
     }
 
-    Value ret;
-    try {
-        m_body->execute(interpreter, environment);
-    } catch (ReturnException& e) {
-        ret = e.value;
-    }
-    return ret;
+    return m_ast->call(interpreter, m_body, environment);
+}
+
+const Chunk* Function::chunk() const
+{
+    return m_chunk;
+}
+
+Environment* Function::closure() const
+{
+    return m_closure;
 }
 
-BlockStatement* Function::body()
+size_t Function::slotCount() const
 {
-    return m_body;
+    return m_slotCount;
 }
 
 size_t Function::paramCount() const
@@ -45,11 +71,34 @@ bool Function::variadic() const
     return m_variadic;
 }
 
+void Function::trace(Visitor& visitor)
+{
+    Object::trace(visitor);
+    if (m_closure) {
+        visitor.visit(m_closure);
+    }
+}
+
+size_t Function::cellSize() const
+{
+    return sizeof(Function);
+}
+
+CellType Function::cellType() const
+{
+    return CellType::Function;
+}
+
 Print::Print()
 {
     m_variadic = true;
 }
 
+size_t Print::cellSize() const
+{
+    return sizeof(Print);
+}
+
 Value Print::execute(Interpreter&, std::vector<Value> arguments)
 {
     for (const auto& argument : arguments) {
@@ -64,10 +113,75 @@ Read::Read()
     m_variadic = true;
 }
 
-Value Read::execute(Interpreter&, std::vector<Value>)
+size_t Read::cellSize() const
+{
+    return sizeof(Read);
+}
+
+Value Read::execute(Interpreter& interpreter, std::vector<Value>)
 {
     std::string line;
     std::getline(std::cin, line);
-    return Value(line);
+    return Value(interpreter.heap().allocate<String>(line));
+}
+
+GCStats::GCStats()
+{
+    m_variadic = false;
+}
+
+size_t GCStats::cellSize() const
+{
+    return sizeof(GCStats);
+}
+
+Value GCStats::execute(Interpreter& interpreter, std::vector<Value>)
+{
+    Heap& heap = interpreter.heap();
+    // Building the result allocates, report the numbers from before.
+    HeapStatistics statistics = heap.statistics();
+    size_t residentBytes = heap.residentBytes();
+    size_t committedBytes = heap.committedBytes();
+    auto number = [](uint64_t count) {
+        return Value(static_cast<double>(count));
+    };
+    auto microseconds = [](auto duration) {
+        return Value(std::chrono::duration<double, std::micro>(duration).count());
+    };
+
+    HandleScope scope(heap);
+    Handle result(heap, heap.allocate<Object>(heap.emptyShape()));
+    auto set = [&heap](const Handle& object, const char* key, Value value) {
+        object.get().object()->set(heap.intern(key), value);
+    };
+    set(result, "minorCollections", number(statistics.minorCollections));
+    set(result, "fullCollections", number(statistics.fullCollections));
+    set(result, "markingSlices", number(statistics.markingSlices));
+    set(result, "compactions", number(statistics.compactions));
+    set(result, "pauses", number(statistics.pauses));
+    set(result, "pauseTime", microseconds(statistics.pauseTime));
+    set(result, "maxPause", microseconds(statistics.maxPause));
+    Handle histogram(heap, heap.allocate<Array>());
+    for (auto count : statistics.pauseHistogram) {
+        histogram.get().array()->append(number(count));
+    }
+    set(result, "pauseHistogram", histogram.get());
+    set(result, "gcTimeRatio", Value(statistics.gcTimeRatio()));
+    set(result, "survivalRate", Value(statistics.survivalRate()));
+    set(result, "peakLiveBytes", number(statistics.peakLiveBytes));
+    set(result, "sweptBytes", number(statistics.sweptBytes));
+    set(result, "movedBytes", number(statistics.movedBytes));
+    set(result, "residentBytes", number(residentBytes));
+    set(result, "committedBytes", number(committedBytes));
+    for (size_t type = 0; type < CellTypeCount; ++type) {
+        const auto& counters = statistics.types[type];
+        Handle object(heap, heap.allocate<Object>(heap.emptyShape()));
+        set(object, "allocatedCells", number(counters.allocatedCells));
+        set(object, "allocatedBytes", number(counters.allocatedBytes));
+        set(object, "freedCells", number(counters.freedCells));
+        set(object, "freedBytes", number(counters.freedBytes));
+        set(result, cellTypeName(static_cast<CellType>(type)), object.get());
+    }
+    return result.get();
 }
 }
@@ -1,6 +1,7 @@
 #pragma once
 
-#include "ast.hpp"
+#include "chunk.hpp"
+#include "flatast.hpp"
 #include "object.hpp"
 
 #include <vector>
@@ -9,30 +10,55 @@ namespace Msl {
 
 class Function : public Object {
 public:
-    Function(BlockStatement* body, std::vector<std::string> params);
+    // A function of the tree-walking engine, running the given body block.
+    Function(const FlatAst* ast, FlatAst::Index body, std::vector<std::string> params,
+        size_t slotCount, Environment* closure);
+    // A function compiled to bytecode.
+    Function(std::vector<std::string> params, size_t slotCount, Environment* closure,
+        const Chunk* chunk);
     virtual Value execute(Interpreter& interpreter, std::vector<Value> arguments);
-    BlockStatement* body();
+    const Chunk* chunk() const;
+    Environment* closure() const;
+    size_t slotCount() const;
     virtual size_t paramCount() const;
     bool variadic() const;
+    virtual void trace(Visitor& visitor) override;
+    virtual size_t cellSize() const override;
+    virtual CellType cellType() const override;
 
 protected:
-    Function() {};
+    Function()
+        : Object(nullptr) {};
     bool m_variadic;
 
 private:
     std::vector<std::string> m_params;
-    BlockStatement* m_body;
+    const FlatAst* m_ast { nullptr };
+    FlatAst::Index m_body { FlatAst::NoNode };
+    size_t m_slotCount { 0 };
+    Environment* m_closure { nullptr };
+    const Chunk* m_chunk { nullptr };
 };
 
 class Print final : public Function {
 public:
     Print();
     virtual Value execute(Interpreter& interpreter, std::vector<Value> arguments) override;
+    virtual size_t cellSize() const override;
 };
 
 class Read final : public Function {
 public:
     Read();
     virtual Value execute(Interpreter& interpreter, std::vector<Value> arguments) override;
+    virtual size_t cellSize() const override;
+};
+
+// Returns a snapshot of the heap statistics as an object.
+class GCStats final : public Function {
+public:
+    GCStats();
+    virtual Value execute(Interpreter& interpreter, std::vector<Value> arguments) override;
+    virtual size_t cellSize() const override;
 };
 }
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "heap.hpp"
+#include "value.hpp"
+
+#include <cassert>
+#include <vector>
+
+namespace Msl {
+
+// Delimits the lifetime of the handles created while it is alive, on
+// destruction it pops them all off the heap's handle stack.
+class HandleScope {
+public:
+    explicit HandleScope(Heap& heap)
+        : m_heap(heap)
+        , m_base(heap.handles().size())
+    {
+    }
+
+    ~HandleScope()
+    {
+        m_heap.handles().resize(m_base);
+    }
+
+    HandleScope(const HandleScope&) = delete;
+    HandleScope& operator=(const HandleScope&) = delete;
+
+private:
+    Heap& m_heap;
+    size_t m_base;
+};
+
+// A value held in a C++ local that the collector must see as a root. It
+// lives on the heap's handle stack until the innermost HandleScope ends.
+class Handle {
+public:
+    Handle(Heap& heap, Value value)
+        : m_handles(&heap.handles())
+        , m_index(m_handles->size())
+    {
+        m_handles->push_back(value);
+    }
+
+    Value get() const
+    {
+        assert(m_index < m_handles->size());
+        return (*m_handles)[m_index];
+    }
+
+    void set(Value value)
+    {
+        assert(m_index < m_handles->size());
+        (*m_handles)[m_index] = value;
+    }
+
+private:
+    std::vector<Value>* m_handles;
+    size_t m_index;
+};
+
+}
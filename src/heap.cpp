@@ -1,96 +1,982 @@
 #include "heap.hpp"
 #include "array.hpp"
+#include "environment.hpp"
+#include "exceptions.hpp"
 #include "function.hpp"
 #include "interpreter.hpp"
+#include "string.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <string>
+#include <unistd.h>
 
 namespace Msl {
 
-Heap::Heap(Interpreter& interpreter)
-    : m_interpreter(interpreter)
+// Limit in a cgroup memory.max or memory.limit_in_bytes file, zero if the
+// file is missing or says unlimited.
+static size_t readCgroupLimit(const std::string& path)
+{
+    std::ifstream file(path);
+    std::string limit;
+    if (!(file >> limit)) {
+        return 0;
+    }
+    char* end;
+    unsigned long long bytes = std::strtoull(limit.c_str(), &end, 10);
+    // cgroup v2 says max, v1 a number close to 2^63 when unlimited.
+    if (*end || bytes >= (1ull << 62)) {
+        return 0;
+    }
+    return bytes;
+}
+
+// Memory the process may use: the tightest limit of the cgroup it runs in
+// and that group's ancestors, or the physical memory if none is set.
+static size_t memoryLimit()
+{
+    size_t limit = 0;
+    auto tighten = [&limit](size_t bytes) {
+        if (bytes && (!limit || bytes < limit)) {
+            limit = bytes;
+        }
+    };
+    // Lines read hierarchy:controllers:path, v2 has an empty controller
+    // list and v1 lists memory for the memory controller.
+    std::ifstream cgroups("/proc/self/cgroup");
+    std::string line;
+    while (std::getline(cgroups, line)) {
+        size_t first = line.find(':');
+        size_t second = line.find(':', first + 1);
+        if (first == std::string::npos || second == std::string::npos) {
+            continue;
+        }
+        std::string controllers = line.substr(first + 1, second - first - 1);
+        std::string group = line.substr(second + 1);
+        std::string root;
+        std::string file;
+        if (controllers.empty()) {
+            root = "/sys/fs/cgroup";
+            file = "/memory.max";
+        } else if (controllers == "memory" || controllers.find("memory,") == 0
+            || controllers.find(",memory") != std::string::npos) {
+            root = "/sys/fs/cgroup/memory";
+            file = "/memory.limit_in_bytes";
+        } else {
+            continue;
+        }
+        for (;;) {
+            tighten(readCgroupLimit(root + group + file));
+            if (group.empty() || group == "/") {
+                break;
+            }
+            group.resize(group.rfind('/'));
+        }
+    }
+    long pages = sysconf(_SC_PHYS_PAGES);
+    long pageSize = sysconf(_SC_PAGE_SIZE);
+    if (pages > 0 && pageSize > 0) {
+        tighten(static_cast<size_t>(pages) * static_cast<size_t>(pageSize));
+    }
+    return limit;
+}
+
+Heap::Heap(Interpreter& interpreter, bool concurrentMarking)
+    : m_concurrentMarking(concurrentMarking)
+    , m_interpreter(interpreter)
+    , m_heapLimit(static_cast<size_t>(memoryLimit() * DefaultHeapLimitFraction))
+    , m_emptyShape(std::make_unique<Shape>())
+{
+}
+
+Heap::~Heap()
+{
+    if (m_markingConcurrently) {
+        stopMarker();
+    }
+    for (auto& sizeClass : m_sizeClasses) {
+        for (auto block : sizeClass.blocks) {
+            block->destroyCells();
+        }
+    }
+}
+
+void* Heap::allocateCell(size_t size)
+{
+    if (m_youngBytes + size > m_allocationLimit) {
+        step(size);
+    }
+    m_youngBytes += size;
+    SizeClass& sizeClass = m_sizeClasses[size / CellAlignment - 1];
+    if (sizeClass.current) {
+        if (void* memory = sizeClass.current->allocate()) {
+            return memory;
+        }
+    }
+    return allocateSlowCase(sizeClass, size);
+}
+
+void* Heap::allocateSlowCase(SizeClass& sizeClass, size_t size)
+{
+    if (void* memory = allocateFromBlocks(sizeClass)) {
+        return memory;
+    }
+    if (!canTakeBlock()) {
+        // Last ditch, the full collection either frees cells of this size
+        // or empties blocks that can be taken.
+        collectLastDitch();
+        if (void* memory = allocateFromBlocks(sizeClass)) {
+            return memory;
+        }
+        if (!canTakeBlock()) {
+            outOfMemory();
+        }
+    }
+    sizeClass.current = takeBlock(size);
+    sizeClass.blocks.push_back(sizeClass.current);
+    return sizeClass.current->allocate();
+}
+
+void* Heap::allocateFromBlocks(SizeClass& sizeClass)
+{
+    for (; sizeClass.next < sizeClass.blocks.size(); ++sizeClass.next) {
+        Block* block = sizeClass.blocks[sizeClass.next];
+        m_statistics.lazySweepTime += sweep(block);
+        if (block->hasFreeCell()) {
+            sizeClass.current = block;
+            return block->allocate();
+        }
+    }
+    return nullptr;
+}
+
+bool Heap::canTakeBlock() const
+{
+    return !m_freeBlocks.empty() || withinLimit(Block::Size);
+}
+
+bool Heap::withinLimit(size_t bytes) const
+{
+    return !m_heapLimit || m_blockBytes + m_payloadBytes + bytes <= m_heapLimit;
+}
+
+void Heap::reservePayload(size_t bytes)
+{
+    if (withinLimit(bytes)) {
+        return;
+    }
+    collectLastDitch();
+    if (!withinLimit(bytes)) {
+        outOfMemory();
+    }
+}
+
+void Heap::collectLastDitch()
+{
+    auto start = Clock::now();
+    collectGarbage();
+    finishSweeping();
+    recordPause(start);
+}
+
+void Heap::outOfMemory() const
+{
+    throw RuntimeException("Out of memory, heap limit of " + std::to_string(m_heapLimit) + " bytes reached");
+}
+
+// Runs once the young generation reaches the allocation limit. That is the
+// nursery size, or while marking every MarkingStepBytes so that slices keep
+// up with the mutator and a finished concurrent marker is noticed early.
+void Heap::step(size_t size)
+{
+    if (m_markingConcurrently) {
+        if (m_markerDone.load(std::memory_order_acquire) || markingOverdue()) {
+            auto start = Clock::now();
+            collectGarbage();
+            recordPause(start);
+        }
+    } else if (m_marking) {
+        markIncrementally();
+    } else if (m_youngBytes + size > NurserySize) {
+        auto start = Clock::now();
+        collectNursery();
+        recordPause(start);
+    }
+    m_allocationLimit = m_marking ? m_youngBytes + std::max(MarkingStepBytes, size) : NurserySize;
+}
+
+Block* Heap::takeBlock(size_t cellSize)
+{
+    void* memory = nullptr;
+    if (m_freeBlocks.empty()) {
+        for (auto& arena : m_arenas) {
+            if ((memory = arena->takeBlock())) {
+                break;
+            }
+        }
+        if (!memory) {
+            m_arenas.push_back(std::make_unique<Arena>());
+            memory = m_arenas.back()->takeBlock();
+        }
+        m_blockBytes += Block::Size;
+    } else {
+        memory = m_freeBlocks.back();
+        m_freeBlocks.pop_back();
+    }
+    return new (memory) Block(this, cellSize);
+}
+
+void Heap::releaseBlock(Block* block)
+{
+    // Keep a few empty blocks around for the next size class to need one.
+    constexpr size_t MaxFreeBlocks = 4;
+    if (m_freeBlocks.size() < MaxFreeBlocks) {
+        m_freeBlocks.push_back(block);
+        return;
+    }
+    auto it = std::find_if(m_arenas.begin(), m_arenas.end(), [block](const auto& arena) {
+        return arena->base() == Arena::base(block);
+    });
+    assert(it != m_arenas.end());
+    (*it)->releaseBlock(block);
+    m_blockBytes -= Block::Size;
+    if ((*it)->empty()) {
+        m_arenas.erase(it);
+    }
+}
+
+Shape* Heap::emptyShape() const
+{
+    return m_emptyShape.get();
+}
+
+String* Heap::intern(std::string_view string)
+{
+    auto it = m_internedStrings.find(string);
+    if (it != m_internedStrings.end()) {
+        return it->second;
+    }
+    // Not on the young list, interned strings are old from the start.
+    constexpr size_t size = cellSize(sizeof(String));
+    auto interned = new (allocateCell(size)) String(std::string(string), true);
+    m_payloadBytes += interned->payloadSize();
+    m_statistics.allocated(CellType::String, size);
+    interned->old(true);
+    if (m_marking) {
+        interned->marked(true);
+    }
+    m_internedStrings.emplace(interned->string(), interned);
+    return interned;
+}
+
+std::vector<Value>& Heap::handles()
+{
+    return m_handles;
+}
+
+double Heap::growthFactor() const
+{
+    return m_growthFactor;
+}
+
+void Heap::growthFactor(double factor)
+{
+    assert(factor > 1.0);
+    m_growthFactor = factor;
+}
+
+size_t Heap::oldGenerationBytes() const
+{
+    return m_oldBytes;
+}
+
+size_t Heap::nextCollectionBytes() const
+{
+    return m_nextCollectionBytes;
+}
+
+bool Heap::incremental() const
+{
+    return m_incremental;
+}
+
+void Heap::incremental(bool incremental)
+{
+    m_incremental = incremental;
+}
+
+std::chrono::microseconds Heap::pauseBudget() const
+{
+    return m_pauseBudget;
+}
+
+void Heap::pauseBudget(std::chrono::microseconds budget)
+{
+    m_pauseBudget = budget;
+}
+
+bool Heap::compaction() const
+{
+    return m_compaction;
+}
+
+void Heap::compaction(bool compaction)
+{
+    m_compaction = compaction;
+}
+
+double Heap::fragmentationThreshold() const
+{
+    return m_fragmentationThreshold;
+}
+
+void Heap::fragmentationThreshold(double threshold)
+{
+    assert(threshold >= 0.0 && threshold < 1.0);
+    m_fragmentationThreshold = threshold;
+}
+
+double Heap::fragmentation() const
+{
+    return m_fragmentation;
+}
+
+size_t Heap::heapLimit() const
+{
+    return m_heapLimit;
+}
+
+void Heap::heapLimit(size_t bytes)
+{
+    m_heapLimit = bytes;
+}
+
+size_t Heap::payloadBytes() const
+{
+    return m_payloadBytes;
+}
+
+size_t Heap::committedBytes() const
+{
+    return m_arenas.size() * Arena::Size;
+}
+
+size_t Heap::residentBytes() const
+{
+    size_t bytes = 0;
+    for (auto& arena : m_arenas) {
+        bytes += arena->residentBytes();
+    }
+    return bytes;
+}
+
+const HeapStatistics& Heap::statistics() const
+{
+    return m_statistics;
+}
+
+void Heap::recordPause(Clock::time_point start)
+{
+    m_statistics.pause(Clock::now() - start);
+}
+
+size_t Heap::markThreads() const
+{
+    return m_markThreads;
+}
+
+void Heap::markThreads(size_t count)
+{
+    assert(count > 0);
+    m_markThreads = count;
+}
+
+bool Heap::concurrentMarking() const
+{
+    return m_concurrentMarking;
+}
+
+bool Heap::markingConcurrently() const
 {
+    return m_markingConcurrently;
+}
+
+void Heap::shade(Cell* cell)
+{
+    // The marker thread owns the gray queue, the snapshot barrier already
+    // covers it.
+    if (!m_markingConcurrently) {
+        m_grayObjects.push(cell);
+    }
 }
 
-bool Heap::gcStatus() const
+void Heap::logOverwritten(Value value)
 {
-    return m_gcStatus;
+    if (value.isCell() && !value.cell()->marked()) {
+        std::lock_guard<std::mutex> guard(m_satbMutex);
+        m_satbBuffer.push_back(value.cell());
+    }
 }
-void Heap::enableGC()
+
+void Heap::remember(Cell* cell)
 {
-    m_gcStatus = true;
+    cell->remembered(true);
+    m_rememberedSet.push_back(cell);
 }
-void Heap::disableGC()
+
+void Heap::forgetRemembered()
 {
-    m_gcStatus = false;
+    for (auto cell : m_rememberedSet) {
+        cell->remembered(false);
+    }
+    m_rememberedSet.clear();
 }
 
+// Also completes an incremental cycle in progress, the gray cells it left
+// are drained together with the rescanned roots.
 void Heap::collectGarbage()
 {
+    m_statistics.fullCollections++;
+    if (m_markingConcurrently) {
+        stopMarker();
+    }
+    if (!m_marking) {
+        finishSweeping();
+    }
+    getRoots();
+    if (m_markThreads > 1) {
+        markInParallel();
+    } else {
+        mark();
+    }
+    if (m_marking) {
+        m_marking = false;
+        Cell::s_markingHeaps--;
+    }
+    finishCollection();
+}
+
+void Heap::startMarking()
+{
+    finishSweeping();
+    m_marking = true;
+    Cell::s_markingHeaps++;
     getRoots();
+    if (m_concurrentMarking) {
+        m_markingConcurrently = true;
+        m_stopMarker = false;
+        m_markerDone = false;
+        m_marker = std::thread(&Heap::markConcurrently, this);
+    }
+}
+
+bool Heap::markingOverdue() const
+{
+    return m_youngBytes >= NurserySize * MaxNurseryGrowth && m_youngBytes >= m_oldBytes;
+}
+
+void Heap::markIncrementally()
+{
+    auto start = Clock::now();
+    m_statistics.markingSlices++;
+    if (markingOverdue() || mark(start + m_pauseBudget)) {
+        collectGarbage();
+    }
+    recordPause(start);
+}
+
+// Body of the marker thread. It owns the gray queue until stopMarker(), and
+// traces each cell under the cell's lock since the mutator keeps writing.
+void Heap::markConcurrently()
+{
+    while (!m_stopMarker.load(std::memory_order_relaxed)) {
+        if (m_grayObjects.empty()) {
+            std::lock_guard<std::mutex> guard(m_satbMutex);
+            if (m_satbBuffer.empty()) {
+                m_markerDone.store(true, std::memory_order_release);
+                return;
+            }
+            for (auto cell : m_satbBuffer) {
+                m_grayObjects.push(cell);
+            }
+            m_satbBuffer.clear();
+            continue;
+        }
+
+        Cell* cell = m_grayObjects.front();
+        m_grayObjects.pop();
+        if (!cell->marked()) {
+            cell->marked(true);
+            std::lock_guard<Cell> guard(*cell);
+            trace(cell);
+        }
+    }
+}
+
+// Joins the marker, its remaining gray cells and whatever the snapshot
+// barrier logged since are left for the remark.
+void Heap::stopMarker()
+{
+    m_stopMarker = true;
+    m_marker.join();
+    m_markingConcurrently = false;
+    for (auto cell : m_satbBuffer) {
+        m_grayObjects.push(cell);
+    }
+    m_satbBuffer.clear();
+}
+
+void Heap::finishCollection()
+{
+    forgetRemembered();
+    // Survivors of the young generation are promoted, the dead are left to
+    // the sweep of their block.
+    for (auto cell : m_youngCells) {
+        size_t size = Block::of(cell)->cellSize();
+        m_statistics.youngBytes += size;
+        if (cell->marked()) {
+            cell->old(true);
+            m_statistics.promotedBytes += size;
+        }
+    }
+    m_youngCells.clear();
+    m_youngBytes = 0;
+
+    m_oldBytes = 0;
+    size_t usedBlockBytes = 0;
+    for (auto& sizeClass : m_sizeClasses) {
+        for (auto block : sizeClass.blocks) {
+            if (size_t marked = block->markedCells()) {
+                m_oldBytes += marked * block->cellSize();
+                usedBlockBytes += Block::Size;
+            }
+            block->swept(false);
+        }
+        sizeClass.current = nullptr;
+        sizeClass.next = 0;
+    }
+    m_fragmentation = usedBlockBytes ? 1.0 - static_cast<double>(m_oldBytes) / usedBlockBytes : 0.0;
+    m_compactionDue = m_compaction && usedBlockBytes >= MinimumHeapSize
+        && m_fragmentation > m_fragmentationThreshold;
+    m_statistics.peakLiveBytes = std::max(m_statistics.peakLiveBytes, m_oldBytes);
+
+    auto next = static_cast<size_t>(static_cast<double>(m_oldBytes) * m_growthFactor);
+    m_nextCollectionBytes = std::max(next, MinimumHeapSize);
+}
+
+void Heap::collectNursery()
+{
+    assert(!m_marking);
+    m_statistics.minorCollections++;
+    m_collectingNursery = true;
+    getRoots();
+    for (auto cell : m_rememberedSet) {
+        trace(cell);
+    }
     mark();
-    sweep();
+    m_collectingNursery = false;
+    forgetRemembered();
+    sweepNursery();
+
+    if (m_oldBytes > m_nextCollectionBytes) {
+        if (m_incremental || m_concurrentMarking) {
+            startMarking();
+        } else {
+            collectGarbage();
+        }
+    }
 }
 
 void Heap::getRoots()
 {
     for (auto& environment : m_interpreter.stack()) {
-        for (auto& variable : environment) {
-            Value value = variable.second;
-            if (value.isObject()) {
-                m_grayObjects.push(value.object());
-            } else if (value.isFunction()) {
-                m_grayObjects.push(value.function());
-            } else if (value.isArray()) {
-                m_grayObjects.push(value.array());
-            }
+        gray(environment);
+    }
+    for (auto& value : m_interpreter.vm().stack()) {
+        gray(value);
+    }
+    for (auto& value : m_handles) {
+        gray(value);
+    }
+    if (!m_collectingNursery) {
+        for (auto& entry : m_internedStrings) {
+            gray(entry.second);
         }
     }
 }
 
+void Heap::gray(Value value)
+{
+    if (value.isCell()) {
+        gray(value.cell());
+    }
+}
+
+// A minor collection treats the old generation as live and does not enter it.
+void Heap::gray(Cell* cell)
+{
+    if (cell && !(m_collectingNursery && cell->old())) {
+        m_grayObjects.push(cell);
+    }
+}
+
 void Heap::mark()
 {
+    mark(Clock::time_point::max());
+}
+
+// Returns whether the gray queue was drained before the deadline.
+bool Heap::mark(Clock::time_point deadline)
+{
+    // Reading the clock is not free, only look at it every so many cells.
+    constexpr size_t CellsPerClockCheck = 256;
+    size_t traced = 0;
     while (!m_grayObjects.empty()) {
-        Object* obj = m_grayObjects.front();
+        Cell* cell = m_grayObjects.front();
+        m_grayObjects.pop();
+
+        if (!cell->marked()) {
+            cell->marked(true);
+            trace(cell);
+            if (++traced % CellsPerClockCheck == 0 && Clock::now() >= deadline) {
+                return m_grayObjects.empty();
+            }
+        }
+    }
+    return true;
+}
+
+// Adapts a callable taking each referenced cell to a Visitor.
+template <typename Callback>
+class CellVisitor final : public Visitor {
+public:
+    explicit CellVisitor(Callback callback)
+        : m_callback(callback)
+    {
+    }
+
+    using Visitor::visit;
+    virtual void visit(Cell* cell) override
+    {
+        m_callback(cell);
+    }
+
+private:
+    Callback m_callback;
+};
+
+void Heap::trace(Cell* cell)
+{
+    CellVisitor visitor([this](Cell* child) { gray(child); });
+    cell->trace(visitor);
+}
+
+// Work stealing marker used by full collections. Every thread drains a
+// private stack and, when that grows while its shared stack is empty, moves
+// half of it there for idle threads to steal. Cells are claimed with an
+// atomic test-and-set of the mark bit, so each is traced exactly once.
+void Heap::markInParallel()
+{
+    // A thread only shares work it has this many cells of.
+    constexpr size_t ShareThreshold = 64;
+
+    struct SharedStack {
+        std::mutex mutex;
+        std::deque<Cell*> cells;
+        std::atomic<size_t> size { 0 };
+    };
+
+    size_t threadCount = m_markThreads;
+    std::vector<SharedStack> shared(threadCount);
+    for (size_t i = 0; !m_grayObjects.empty(); ++i) {
+        auto& stack = shared[i % threadCount];
+        stack.cells.push_back(m_grayObjects.front());
+        stack.size = stack.cells.size();
         m_grayObjects.pop();
+    }
+    std::atomic<size_t> active { threadCount };
+
+    auto take = [&](SharedStack& stack, std::vector<Cell*>& local, bool all) {
+        if (!stack.size.load(std::memory_order_acquire)) {
+            return;
+        }
+        std::lock_guard<std::mutex> guard(stack.mutex);
+        size_t count = all ? stack.cells.size() : (stack.cells.size() + 1) / 2;
+        local.insert(local.end(), stack.cells.begin(), stack.cells.begin() + count);
+        stack.cells.erase(stack.cells.begin(), stack.cells.begin() + count);
+        stack.size.store(stack.cells.size(), std::memory_order_release);
+    };
 
-        if (!obj->marked()) {
-            obj->marked(true);
-            for (const auto& prop : obj->properties()) {
-                auto val = prop.second;
-                if (val.isObject()) {
-                    m_grayObjects.push(val.object());
-                } else if (val.isArray()) {
-                    m_grayObjects.push(val.array());
-                } else if (val.isFunction()) {
-                    m_grayObjects.push(val.function());
+    auto work = [&](size_t id) {
+        std::vector<Cell*> local;
+        SharedStack& own = shared[id];
+        for (;;) {
+            if (local.empty()) {
+                take(own, local, true);
+                for (size_t i = 1; local.empty() && i < threadCount; ++i) {
+                    take(shared[(id + i) % threadCount], local, false);
                 }
             }
-            if (auto array = dynamic_cast<Array*>(obj)) {
-                for (auto& element : array->elements()) {
-                    if (element.isObject()) {
-                        m_grayObjects.push(element.object());
-                    } else if (element.isArray()) {
-                        m_grayObjects.push(element.array());
-                    } else if (element.isFunction()) {
-                        m_grayObjects.push(element.function());
+            if (local.empty()) {
+                // No thread pushes to a shared stack while idle, so once none
+                // is active all the work is done.
+                active.fetch_sub(1);
+                for (;;) {
+                    bool found = std::any_of(shared.begin(), shared.end(),
+                        [](SharedStack& stack) { return stack.size.load(std::memory_order_acquire); });
+                    if (found) {
+                        active.fetch_add(1);
+                        break;
                     }
+                    if (!active.load()) {
+                        return;
+                    }
+                    std::this_thread::yield();
+                }
+                continue;
+            }
+
+            Cell* cell = local.back();
+            local.pop_back();
+            if (!cell->tryMark()) {
+                continue;
+            }
+            CellVisitor visitor([&local](Cell* child) {
+                if (!child->marked()) {
+                    local.push_back(child);
                 }
+            });
+            cell->trace(visitor);
+            if (local.size() > ShareThreshold && !own.size.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> guard(own.mutex);
+                size_t half = local.size() / 2;
+                own.cells.insert(own.cells.end(), local.begin(), local.begin() + half);
+                local.erase(local.begin(), local.begin() + half);
+                own.size.store(own.cells.size(), std::memory_order_release);
             }
         }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t id = 1; id < threadCount; ++id) {
+        threads.emplace_back(work, id);
+    }
+    work(0);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+void Heap::compact()
+{
+    auto start = Clock::now();
+    m_statistics.compactions++;
+    m_compactionDue = false;
+    finishSweeping();
+
+    bool moved = false;
+    for (auto& sizeClass : m_sizeClasses) {
+        moved |= evacuate(sizeClass);
+    }
+    if (moved) {
+        for (auto& value : m_interpreter.vm().stack()) {
+            value = forwarded(value);
+        }
+        for (auto& value : m_handles) {
+            value = forwarded(value);
+        }
+        for (auto& cell : m_youngCells) {
+            cell = forwarded(cell);
+        }
+        for (auto& cell : m_rememberedSet) {
+            cell = forwarded(cell);
+        }
+        for (auto& sizeClass : m_sizeClasses) {
+            for (auto block : sizeClass.blocks) {
+                block->forEachCell([this](Cell* cell) { updateReferences(cell); });
+            }
+        }
+        for (auto& sizeClass : m_sizeClasses) {
+            for (auto block : sizeClass.blocks) {
+                block->evacuating(false);
+            }
+        }
+        // Releases the blocks that were emptied.
+        finishSweeping();
     }
+    recordPause(start);
 }
 
-void Heap::sweep()
+// Moves the objects of the sparsest blocks into the free slots of the
+// densest ones, as many blocks as those free slots can take in.
+bool Heap::evacuate(SizeClass& sizeClass)
 {
-    for (auto it = m_liveObjects.begin(); it != m_liveObjects.end();) {
-        auto obj = *it;
-        if (!obj->marked()) {
-            delete obj;
-            it = m_liveObjects.erase(it);
+    auto& blocks = sizeClass.blocks;
+    std::sort(blocks.begin(), blocks.end(),
+        [](Block* a, Block* b) { return a->liveCells() < b->liveCells(); });
+
+    size_t freeCells = 0;
+    for (auto block : blocks) {
+        freeCells += block->cellCount() - block->liveCells();
+    }
+    size_t candidates = 0;
+    size_t moving = 0;
+    for (; candidates < blocks.size(); ++candidates) {
+        Block* block = blocks[candidates];
+        freeCells -= block->cellCount() - block->liveCells();
+        if (moving + block->liveCells() > freeCells) {
+            break;
+        }
+        moving += block->liveCells();
+    }
+    if (!candidates) {
+        return false;
+    }
+
+    size_t target = candidates;
+    for (size_t i = 0; i < candidates; ++i) {
+        Block* block = blocks[i];
+        block->evacuating(true);
+        block->forEachCell([&](Cell* cell) {
+            CellType type = cell->cellType();
+            if (type != CellType::Object && type != CellType::Array && type != CellType::Function) {
+                return;
+            }
+            void* memory = nullptr;
+            while (target < blocks.size() && !(memory = blocks[target]->allocate())) {
+                target++;
+            }
+            assert(memory && cell->cellSize() <= block->cellSize());
+            // Objects, arrays and functions only hold pointers and vectors,
+            // which stay valid when their bytes are copied elsewhere.
+            std::memcpy(memory, static_cast<void*>(cell), cell->cellSize());
+            block->forward(cell, static_cast<Cell*>(memory));
+            m_statistics.movedBytes += block->cellSize();
+        });
+    }
+    return true;
+}
+
+Cell* Heap::forwarded(Cell* cell) const
+{
+    Block* block = Block::of(cell);
+    if (block->evacuating() && !block->allocated(cell)) {
+        return block->forwardingAddress(cell);
+    }
+    return cell;
+}
+
+Value Heap::forwarded(Value value) const
+{
+    if (!value.isCell()) {
+        return value;
+    }
+    Cell* cell = forwarded(value.cell());
+    switch (value.type()) {
+    case Value::Type::Object:
+        return static_cast<Object*>(cell);
+    case Value::Type::Array:
+        return static_cast<Array*>(cell);
+    case Value::Type::Function:
+        return static_cast<Function*>(cell);
+    default:
+        return value;
+    }
+}
+
+void Heap::updateReferences(Cell* cell)
+{
+    // Only cells referenced through values move.
+    class ForwardingVisitor final : public Visitor {
+    public:
+        explicit ForwardingVisitor(const Heap& heap)
+            : m_heap(heap)
+        {
+        }
+
+        virtual void visit(Cell*) override
+        {
+        }
+
+        virtual void visit(Value& value) override
+        {
+            value = m_heap.forwarded(value);
+        }
+
+    private:
+        const Heap& m_heap;
+    };
+
+    ForwardingVisitor visitor(*this);
+    cell->trace(visitor);
+}
+
+Heap::Clock::duration Heap::sweep(Block* block)
+{
+    if (block->swept()) {
+        return Clock::duration::zero();
+    }
+    auto start = Clock::now();
+    m_statistics.sweptBytes += block->sweep(m_statistics) * block->cellSize();
+    auto duration = Clock::now() - start;
+    m_statistics.sweepTime += duration;
+    return duration;
+}
+
+// Sweeps the blocks allocation has not got to since the last full
+// collection, which must happen before marking starts again. Blocks left
+// empty are released.
+void Heap::finishSweeping()
+{
+    for (auto& sizeClass : m_sizeClasses) {
+        size_t live = 0;
+        for (auto block : sizeClass.blocks) {
+            sweep(block);
+            if (block->liveCells()) {
+                sizeClass.blocks[live++] = block;
+            } else {
+                releaseBlock(block);
+            }
+        }
+        sizeClass.blocks.resize(live);
+        sizeClass.current = nullptr;
+        sizeClass.next = 0;
+    }
+}
+
+// Survivors are promoted where they are, the slots of the dead go back to
+// the free lists of their blocks.
+void Heap::sweepNursery()
+{
+    auto start = Clock::now();
+    for (auto cell : m_youngCells) {
+        Block* block = Block::of(cell);
+        m_statistics.youngBytes += block->cellSize();
+        if (block->marked(cell)) {
+            block->marked(cell, false);
+            cell->old(true);
+            m_oldBytes += block->cellSize();
+            m_statistics.promotedBytes += block->cellSize();
         } else {
-            obj->marked(false);
-            ++it;
+            m_statistics.freed(cell->cellType(), block->cellSize());
+            m_statistics.sweptBytes += block->cellSize();
+            payloadFreed(cell->payloadSize());
+            cell->~Cell();
+            block->free(cell);
         }
     }
+    m_youngCells.clear();
+    m_youngBytes = 0;
+    m_statistics.peakLiveBytes = std::max(m_statistics.peakLiveBytes, m_oldBytes);
+
+    for (auto& sizeClass : m_sizeClasses) {
+        sizeClass.next = 0;
+    }
+    m_statistics.sweepTime += Clock::now() - start;
 }
 
 }
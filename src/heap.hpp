@@ -1,44 +1,274 @@
 #pragma once
 
+#include "arena.hpp"
+#include "block.hpp"
+#include "cell.hpp"
 #include "forward.hpp"
-#include "object.hpp"
+#include "heapstatistics.hpp"
+#include "shape.hpp"
+#include "string.hpp"
+#include "value.hpp"
 
-#include <list>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <queue>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 namespace Msl {
 
+// Generational heap. Cells live in blocks segregated by size class and are
+// allocated from the block's free list, the young generation is simply the
+// list of cells allocated since the last collection. A minor collection
+// traces from the roots and the remembered set only, promotes the survivors
+// in place and gives the dead slots back to their blocks. A full collection
+// marks everything into the blocks' mark bitmaps, it runs once the old
+// generation outgrows the live size left by the previous one by the growth
+// factor. Sweeping is lazy: allocation sweeps a block when it first looks at
+// it, and the next full collection sweeps whatever is left before marking.
+//
+// With compaction on, a full collection that leaves too much of the blocks
+// unused asks for the objects, arrays and functions of the sparsest blocks
+// to be moved into the free slots of the densest. Moving happens at the next
+// safepoint, where no C++ frame holds a pointer to a cell. Strings and
+// environments are referenced by raw pointers and never move.
+//
+// In incremental mode a full collection instead marks in slices of at most
+// the pause budget, one every MarkingStepBytes of allocation, with the
+// write barrier shading stores into marked cells. Cells allocated meanwhile
+// are black, their constructor arguments shaded right away. Nursery
+// collections wait for the cycle to finish and the roots are scanned again
+// before sweeping.
+//
+// A heap built for concurrent marking hands full marking to a helper thread
+// instead, the mutator only pauses to gray the roots and for the final
+// remark. Stores log the value they overwrite (a snapshot at the beginning
+// barrier) and lock the cell against the marker, see Cell::write().
 class Heap {
 public:
-    Heap(Interpreter& interpreter);
+    static constexpr size_t CellAlignment = Block::CellAlignment;
+    // Size classes step by CellAlignment up to the largest cell type.
+    static constexpr size_t MaxCellSize = 256;
+    static constexpr size_t SizeClassCount = MaxCellSize / CellAlignment;
+    // Bytes allocated between two minor collections.
+    static constexpr size_t NurserySize = 256 * 1024;
+    static constexpr double DefaultGrowthFactor = 2.0;
+    // Full collections never trigger below this many old generation bytes.
+    static constexpr size_t MinimumHeapSize = 1024 * 1024;
+    // While incremental marking runs the nursery grows instead of being
+    // collected. Once it is this many times its size and larger than the old
+    // generation, marking is finished at once.
+    static constexpr size_t MaxNurseryGrowth = 8;
+    static constexpr size_t MarkingStepBytes = Block::Size / 8;
+    static constexpr std::chrono::microseconds DefaultPauseBudget { 1000 };
+    static constexpr double DefaultFragmentationThreshold = 0.5;
+    // Share of the memory limit the heap defaults to, the rest is left for
+    // temporaries and the interpreter itself. The limit is the cgroup's, or
+    // the physical memory outside of one.
+    static constexpr double DefaultHeapLimitFraction = 0.75;
+
+    explicit Heap(Interpreter& interpreter, bool concurrentMarking = false);
+    ~Heap();
 
     template <typename T, typename... Args>
     T* allocate(Args&&... args)
     {
-        if (m_gcStatus == true && m_liveObjects.size() > m_threshold) {
-            collectGarbage();
+        static_assert(sizeof(T) <= MaxCellSize, "cell type too large for the size classes");
+        constexpr size_t size = cellSize(sizeof(T));
+        T* cell = new (allocateCell(size)) T(std::forward<Args>(args)...);
+        m_payloadBytes += cell->payloadSize();
+        m_youngCells.push_back(cell);
+        m_statistics.allocated(cell->cellType(), size);
+        if (m_marking) {
+            cell->marked(true);
+            if (!m_markingConcurrently) {
+                trace(cell);
+            }
         }
-        T* object = new T(std::forward<Args>(args)...);
-        m_liveObjects.emplace_front(object);
-        return object;
+        return cell;
+    }
+
+    static constexpr size_t cellSize(size_t size)
+    {
+        return (size + CellAlignment - 1) & ~(CellAlignment - 1);
     }
 
-    bool gcStatus() const;
-    void enableGC();
-    void disableGC();
+    String* intern(std::string_view string);
+    Shape* emptyShape() const;
+
+    // Values rooted by Handle, see handle.hpp.
+    std::vector<Value>& handles();
+
+    // Called by the write barrier for an old cell now pointing at a young one.
+    void remember(Cell* cell);
+    // Called by the write barrier for a white cell stored into a marked one.
+    void shade(Cell* cell);
+    // Called by the snapshot barrier for a value about to be overwritten.
+    void logOverwritten(Value value);
+    bool markingConcurrently() const;
 
     void collectGarbage();
+    void collectNursery();
+
+    // Called where every reference to a cell is in the roots or in another
+    // cell, runs a compaction if one is due.
+    void safepoint()
+    {
+        if (m_compactionDue && !m_marking) {
+            compact();
+        }
+    }
+
+    // Pacing of full collections, the next one is due once the old
+    // generation holds growthFactor times the bytes that survived the last.
+    double growthFactor() const;
+    void growthFactor(double factor);
+    size_t oldGenerationBytes() const;
+    size_t nextCollectionBytes() const;
+
+    bool incremental() const;
+    void incremental(bool incremental);
+    bool concurrentMarking() const;
+    // Threads marking in parallel during the stop-the-world part of a full
+    // collection. Nursery collections are small and stay on one thread.
+    size_t markThreads() const;
+    void markThreads(size_t count);
+    std::chrono::microseconds pauseBudget() const;
+    void pauseBudget(std::chrono::microseconds budget);
+    bool compaction() const;
+    void compaction(bool compaction);
+    // Fraction of the blocks holding live cells that may be unused before a
+    // compaction is due.
+    double fragmentationThreshold() const;
+    void fragmentationThreshold(double threshold);
+    // Unused fraction of the blocks after the last full collection.
+    double fragmentation() const;
+    const HeapStatistics& statistics() const;
+
+    // Bytes of blocks and cell payloads the heap may hold, zero for no
+    // limit. A block that would exceed it is only taken if a full collection
+    // cannot free one, otherwise allocation throws a RuntimeException.
+    size_t heapLimit() const;
+    void heapLimit(size_t bytes);
+    // Bytes the live and not yet swept cells own outside their blocks, see
+    // Cell::payloadSize().
+    size_t payloadBytes() const;
+    void payloadAllocated(size_t bytes) { m_payloadBytes += bytes; }
+    void payloadFreed(size_t bytes)
+    {
+        assert(bytes <= m_payloadBytes);
+        m_payloadBytes -= bytes;
+    }
+    // Called before building the payload of a cell about to be allocated,
+    // throws like a block allocation if it would not fit under the limit
+    // even after a full collection.
+    void reservePayload(size_t bytes);
+    // Bytes of address space mapped for arenas.
+    size_t committedBytes() const;
+    // Bytes of the arenas backed by physical memory, empty blocks are
+    // returned to the OS.
+    size_t residentBytes() const;
+
+private:
+    // Blocks holding cells of one size. Allocation goes through current
+    // until it is full, then looks for free slots in the following blocks.
+    struct SizeClass {
+        std::vector<Block*> blocks;
+        Block* current { nullptr };
+        size_t next { 0 };
+    };
+
+    void* allocateCell(size_t size);
+    void* allocateSlowCase(SizeClass& sizeClass, size_t size);
+    void* allocateFromBlocks(SizeClass& sizeClass);
+    bool canTakeBlock() const;
+    bool withinLimit(size_t bytes) const;
+    void collectLastDitch();
+    [[noreturn]] void outOfMemory() const;
+    void step(size_t size);
+    Block* takeBlock(size_t cellSize);
+    void releaseBlock(Block* block);
+
+    using Clock = std::chrono::steady_clock;
+
+    void startMarking();
+    bool markingOverdue() const;
+    void markIncrementally();
+    void markConcurrently();
+    void stopMarker();
+    void finishCollection();
+    void recordPause(Clock::time_point start);
+
     void getRoots();
     void mark();
-    void sweep();
+    bool mark(Clock::time_point deadline);
+    void markInParallel();
+    void trace(Cell* cell);
+    void gray(Value value);
+    void gray(Cell* cell);
+    void forgetRemembered();
+    void compact();
+    bool evacuate(SizeClass& sizeClass);
+    Cell* forwarded(Cell* cell) const;
+    Value forwarded(Value value) const;
+    void updateReferences(Cell* cell);
+    Clock::duration sweep(Block* block);
+    void finishSweeping();
+    void sweepNursery();
 
-private:
-    bool m_gcStatus { true };
-    size_t m_threshold { 20 };
+    double m_growthFactor { DefaultGrowthFactor };
+    size_t m_oldBytes { 0 };
+    size_t m_nextCollectionBytes { MinimumHeapSize };
+    bool m_collectingNursery { false };
+    bool m_incremental { false };
+    bool m_marking { false };
+    bool m_concurrentMarking;
+    bool m_markingConcurrently { false };
+    size_t m_markThreads { 1 };
+    std::chrono::microseconds m_pauseBudget { DefaultPauseBudget };
+    bool m_compaction { false };
+    bool m_compactionDue { false };
+    double m_fragmentationThreshold { DefaultFragmentationThreshold };
+    double m_fragmentation { 0 };
+    HeapStatistics m_statistics;
     Interpreter& m_interpreter;
-    std::queue<Object*> m_grayObjects;
-    std::list<Object*> m_liveObjects;
+    std::queue<Cell*> m_grayObjects;
+    std::vector<Value> m_handles;
+
+    SizeClass m_sizeClasses[SizeClassCount];
+    std::vector<Block*> m_freeBlocks;
+    std::vector<std::unique_ptr<Arena>> m_arenas;
+    size_t m_heapLimit;
+    // Bytes of all blocks taken from the arenas, in use or free.
+    size_t m_blockBytes { 0 };
+    size_t m_payloadBytes { 0 };
+    // Bytes allocated since the last minor collection, step() runs once they
+    // reach the allocation limit.
+    size_t m_youngBytes { 0 };
+    size_t m_allocationLimit { NurserySize };
+    std::vector<Cell*> m_youngCells;
+    std::vector<Cell*> m_rememberedSet;
+
+    std::thread m_marker;
+    std::atomic<bool> m_stopMarker { false };
+    std::atomic<bool> m_markerDone { false };
+    // Cells logged by the snapshot barrier, drained by the marker.
+    std::mutex m_satbMutex;
+    std::vector<Cell*> m_satbBuffer;
+
+    // Interned strings are old cells that full collections treat as roots,
+    // keys view the contents of their cell.
+    std::unordered_map<std::string_view, String*> m_internedStrings;
+    // Root of the shape transition tree shared by all objects of this heap.
+    std::unique_ptr<Shape> m_emptyShape;
 };
 
 };
@@ -0,0 +1,82 @@
+#include "heapstatistics.hpp"
+
+#include <algorithm>
+#include <string>
+
+namespace Msl {
+
+const char* cellTypeName(CellType type)
+{
+    static const char* const names[CellTypeCount] = { "Object", "Array", "Function", "String", "Environment" };
+    return names[static_cast<size_t>(type)];
+}
+
+static std::string bucketName(size_t bucket)
+{
+    if (!bucket) {
+        return "<1us";
+    }
+    std::string low = std::to_string(uint64_t(1) << (bucket - 1));
+    if (bucket == HeapStatistics::PauseBuckets - 1) {
+        return ">=" + low + "us";
+    }
+    return low + "-" + std::to_string(uint64_t(1) << bucket) + "us";
+}
+
+void HeapStatistics::pause(Clock::duration duration)
+{
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(duration);
+    size_t bucket = 0;
+    for (auto count = us.count(); count && bucket < PauseBuckets - 1; count >>= 1) {
+        bucket++;
+    }
+    pauses++;
+    pauseHistogram[bucket]++;
+    pauseTime += duration;
+    maxPause = std::max(maxPause, us);
+}
+
+double HeapStatistics::gcTimeRatio() const
+{
+    auto total = Clock::now() - start;
+    if (total.count() <= 0) {
+        return 0.0;
+    }
+    return std::chrono::duration<double>(pauseTime + lazySweepTime) / total;
+}
+
+double HeapStatistics::survivalRate() const
+{
+    return youngBytes ? static_cast<double>(promotedBytes) / youngBytes : 0.0;
+}
+
+void HeapStatistics::print(std::ostream& os) const
+{
+    auto us = [](Clock::duration duration) {
+        return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+    };
+    os << "GC statistics:" << std::endl;
+    os << "  collections: " << minorCollections << " minor, " << fullCollections << " full, "
+       << markingSlices << " marking slices, " << compactions << " compactions" << std::endl;
+    os << "  pauses: " << pauses << ", " << us(pauseTime) << "us total, "
+       << maxPause.count() << "us max" << std::endl;
+    for (size_t bucket = 0; bucket < PauseBuckets; ++bucket) {
+        if (pauseHistogram[bucket]) {
+            os << "    " << bucketName(bucket) << ": " << pauseHistogram[bucket] << std::endl;
+        }
+    }
+    os << "  time in GC: " << gcTimeRatio() * 100 << "% (" << us(lazySweepTime)
+       << "us sweeping outside pauses)" << std::endl;
+    os << "  swept: " << sweptBytes << " bytes in " << us(sweepTime) << "us, moved: "
+       << movedBytes << " bytes" << std::endl;
+    os << "  survival: " << survivalRate() * 100 << "% of " << youngBytes
+       << " young bytes, peak live: " << peakLiveBytes << " bytes" << std::endl;
+    for (size_t type = 0; type < CellTypeCount; ++type) {
+        const TypeCounters& counters = types[type];
+        os << "  " << cellTypeName(static_cast<CellType>(type)) << ": " << counters.allocatedCells << " allocated ("
+           << counters.allocatedBytes << " bytes), " << counters.freedCells << " freed ("
+           << counters.freedBytes << " bytes)" << std::endl;
+    }
+}
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "cell.hpp"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+namespace Msl {
+
+const char* cellTypeName(CellType type);
+
+// Counters the heap keeps over the whole run, see Heap::statistics().
+struct HeapStatistics {
+    using Clock = std::chrono::steady_clock;
+
+    // Bucket 0 counts pauses under a microsecond, bucket i pauses of
+    // [2^(i-1), 2^i) microseconds and the last one everything longer.
+    static constexpr size_t PauseBuckets = 20;
+
+    struct TypeCounters {
+        uint64_t allocatedCells { 0 };
+        uint64_t allocatedBytes { 0 };
+        uint64_t freedCells { 0 };
+        uint64_t freedBytes { 0 };
+    };
+
+    void allocated(CellType type, size_t bytes)
+    {
+        auto& counters = types[static_cast<size_t>(type)];
+        counters.allocatedCells++;
+        counters.allocatedBytes += bytes;
+    }
+
+    void freed(CellType type, size_t bytes)
+    {
+        auto& counters = types[static_cast<size_t>(type)];
+        counters.freedCells++;
+        counters.freedBytes += bytes;
+    }
+
+    void pause(Clock::duration duration);
+    // Share of the run the mutator spent stopped for the collector or
+    // sweeping on its behalf. The concurrent marker is not counted.
+    double gcTimeRatio() const;
+    // Share of the young generation bytes that survived their first
+    // collection.
+    double survivalRate() const;
+    void print(std::ostream& os) const;
+
+    Clock::time_point start { Clock::now() };
+    uint64_t minorCollections { 0 };
+    uint64_t fullCollections { 0 };
+    uint64_t markingSlices { 0 };
+    uint64_t compactions { 0 };
+    uint64_t pauses { 0 };
+    uint64_t pauseHistogram[PauseBuckets] {};
+    Clock::duration pauseTime { 0 };
+    std::chrono::microseconds maxPause { 0 };
+    // Time spent sweeping blocks on allocation, outside of any pause.
+    Clock::duration lazySweepTime { 0 };
+    Clock::duration sweepTime { 0 };
+    uint64_t sweptBytes { 0 };
+    uint64_t movedBytes { 0 };
+    uint64_t youngBytes { 0 };
+    uint64_t promotedBytes { 0 };
+    size_t peakLiveBytes { 0 };
+    TypeCounters types[CellTypeCount];
+};
+
+}
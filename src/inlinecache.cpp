@@ -0,0 +1,40 @@
+#include "inlinecache.hpp"
+
+namespace Msl {
+
+InlineCache::InlineCache()
+{
+}
+
+void InlineCache::update(const Shape* shape, uint32_t offset)
+{
+    if (m_megamorphic)
+        return;
+    if (m_size == Capacity) {
+        m_megamorphic = true;
+        m_size = 0;
+        return;
+    }
+    m_entries[m_size++] = { shape, offset };
+}
+
+InlineCache::State InlineCache::state() const
+{
+    if (m_megamorphic)
+        return State::Megamorphic;
+    if (m_size == 0)
+        return State::Uninitialized;
+    return m_size == 1 ? State::Monomorphic : State::Polymorphic;
+}
+
+uint64_t InlineCache::hits() const
+{
+    return m_hits;
+}
+
+uint64_t InlineCache::misses() const
+{
+    return m_misses;
+}
+
+}
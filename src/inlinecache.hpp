@@ -0,0 +1,56 @@
+#pragma once
+
+#include "shape.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace Msl {
+
+// Per-site cache of the slot offset a property key has in the shapes seen at
+// that site. Holds up to Capacity shapes, a site that sees more is marked
+// megamorphic and falls back to the shape lookup for good.
+class InlineCache {
+public:
+    static constexpr size_t Capacity = 4;
+
+    enum class State {
+        Uninitialized,
+        Monomorphic,
+        Polymorphic,
+        Megamorphic
+    };
+
+    InlineCache();
+
+    uint32_t offset(const Shape* shape)
+    {
+        for (size_t i = 0; i < m_size; ++i) {
+            if (m_entries[i].shape == shape) {
+                m_hits++;
+                return m_entries[i].offset;
+            }
+        }
+        m_misses++;
+        return Shape::NotFound;
+    }
+
+    void update(const Shape* shape, uint32_t offset);
+    State state() const;
+    uint64_t hits() const;
+    uint64_t misses() const;
+
+private:
+    struct Entry {
+        const Shape* shape;
+        uint32_t offset;
+    };
+
+    Entry m_entries[Capacity] {};
+    size_t m_size { 0 };
+    bool m_megamorphic { false };
+    uint64_t m_hits { 0 };
+    uint64_t m_misses { 0 };
+};
+
+}
@@ -1,56 +1,82 @@
 #include "interpreter.hpp"
+#include "compiler.hpp"
+#include "environment.hpp"
 #include "exceptions.hpp"
 #include "function.hpp"
 #include "heap.hpp"
+#include "resolver.hpp"
 
 #include <iostream>
 
 namespace Msl {
 
-Interpreter::Interpreter()
-    : m_heap(*this)
+Interpreter::Interpreter(Engine engine, bool concurrentMarking)
+    : m_engine(engine)
+    , m_heap(*this, concurrentMarking)
     , m_stack({})
+    , m_vm(*this)
 {
 }
 
+static const std::vector<std::string> nativeFunctions = { "Print", "Read", "GCStats" };
+
 void Interpreter::run(Program* program)
 {
-    Environment globals;
+    Resolver resolver(m_heap);
+    resolver.resolve(program, nativeFunctions);
+    m_propertySites = resolver.propertySites();
+
+    auto globals = m_heap.allocate<Environment>(nullptr, program->slotCount());
+    m_stack.push_back(globals);
     loadNativeFunctions(globals);
-    program->execute(*this, globals);
-}
 
-Value Interpreter::getVariable(const std::string& name)
-{
-    for (ssize_t i = m_stack.size() - 1; i >= 0; --i) {
-        auto it = m_stack[i].find(name);
-        if (it != m_stack[i].end()) {
-            return it->second;
-        }
+    if (m_engine == Engine::Ast) {
+        m_ast = std::make_unique<FlatAst>(*program);
+        m_ast->run(*this);
+    } else {
+        Compiler compiler;
+        m_chunk = compiler.compile(program);
+        m_vm.run(*m_chunk);
     }
-
-    throw RuntimeException("Variable is undefined");
+    m_stack.pop_back();
 }
 
-void Interpreter::declareVariable(const std::string& name, Msl::Value value)
+static const char* inlineCacheStateName(InlineCache::State state)
 {
-    auto res = m_stack.back().emplace(name, value);
-    if (!res.second) {
-        throw RuntimeException("Variable already exists");
+    switch (state) {
+    case InlineCache::State::Uninitialized:
+        return "uninitialized";
+    case InlineCache::State::Monomorphic:
+        return "monomorphic";
+    case InlineCache::State::Polymorphic:
+        return "polymorphic";
+    case InlineCache::State::Megamorphic:
+        return "megamorphic";
     }
+    return "";
 }
 
-Value Interpreter::updateVariable(const std::string& name, Msl::Value value)
+void Interpreter::printInlineCacheStats(std::ostream& os) const
 {
-    for (ssize_t i = m_stack.size() - 1; i >= 0; --i) {
-        auto it = m_stack[i].find(name);
-        if (it != m_stack[i].end()) {
-            it->second = value;
-            return it->second;
-        }
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    os << "Inline caches:" << std::endl;
+    for (auto site : m_propertySites) {
+        const InlineCache& cache = site->cache();
+        os << "  line " << site->line() << " ." << site->property()->name()
+           << ": " << inlineCacheStateName(cache.state())
+           << ", " << cache.hits() << " hits, " << cache.misses() << " misses"
+           << std::endl;
+        hits += cache.hits();
+        misses += cache.misses();
     }
+    os << "  total: " << m_propertySites.size() << " sites, " << hits << " hits, "
+       << misses << " misses" << std::endl;
+}
 
-    throw RuntimeException("Variable doesn't Exist");
+Environment* Interpreter::environment()
+{
+    return m_stack.back();
 }
 
 Heap& Interpreter::heap()
@@ -63,12 +89,16 @@ Stack& Interpreter::stack()
     return m_stack;
 }
 
-void Interpreter::loadNativeFunctions(Environment& environment)
+VM& Interpreter::vm()
+{
+    return m_vm;
+}
+
+void Interpreter::loadNativeFunctions(Environment* globals)
 {
-    Print* print = m_heap.allocate<Print>();
-    Read* read = m_heap.allocate<Read>();
-    environment.emplace("Print", Value(print));
-    environment.emplace("Read", Value(read));
+    globals->set(0, Value(m_heap.allocate<Print>()));
+    globals->set(1, Value(m_heap.allocate<Read>()));
+    globals->set(2, Value(m_heap.allocate<GCStats>()));
 }
 
 }
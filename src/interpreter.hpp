@@ -1,28 +1,44 @@
 #pragma once
 
 #include "ast.hpp"
+#include "chunk.hpp"
+#include "flatast.hpp"
 #include "heap.hpp"
-#include <unordered_map>
+#include "vm.hpp"
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
 
 namespace Msl {
 
-typedef std::unordered_map<std::string, Value> Environment;
-typedef std::vector<Environment> Stack;
+typedef std::vector<Environment*> Stack;
 
 class Interpreter {
 public:
-    Interpreter();
+    enum class Engine {
+        Ast,
+        Bytecode
+    };
+
+    explicit Interpreter(Engine engine = Engine::Bytecode, bool concurrentMarking = false);
     void run(Program* program);
+    void printInlineCacheStats(std::ostream& os) const;
     Heap& heap();
     Stack& stack();
-    Value getVariable(const std::string& name);
-    void declareVariable(const std::string& name, Value value);
-    Value updateVariable(const std::string& name, Value value);
+    VM& vm();
+    Environment* environment();
 
 private:
+    Engine m_engine;
     Heap m_heap;
     Stack m_stack;
+    VM m_vm;
+    std::unique_ptr<FlatAst> m_ast;
+    std::unique_ptr<Chunk> m_chunk;
+    std::vector<const MemberExpression*> m_propertySites;
 
-    void loadNativeFunctions(Environment& environment);
+    void loadNativeFunctions(Environment* globals);
 };
 }
@@ -1,11 +1,54 @@
-#include <cctype>
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <string>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "error.hpp"
 #include "lexer.hpp"
 
 namespace Msl {
 
-const std::unordered_map<std::string_view, Token::Type> Lexer::keywords = {
+enum CharacterClass : uint8_t {
+    Blank = 1 << 0,
+    Newline = 1 << 1,
+    Digit = 1 << 2,
+    Alpha = 1 << 3,
+};
+
+static constexpr std::array<uint8_t, 256> makeCharacterClasses()
+{
+    std::array<uint8_t, 256> classes {};
+    for (unsigned c = 0; c < 256; ++c) {
+        if (c == ' ' || c == '\t' || c == '\v' || c == '\f' || c == '\r')
+            classes[c] |= Blank;
+        if (c == '\n')
+            classes[c] |= Newline;
+        if (c >= '0' && c <= '9')
+            classes[c] |= Digit;
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'))
+            classes[c] |= Alpha;
+    }
+    return classes;
+}
+
+static constexpr std::array<uint8_t, 256> characterClasses = makeCharacterClasses();
+
+static bool is(char c, uint8_t classes)
+{
+    return characterClasses[static_cast<unsigned char>(c)] & classes;
+}
+
+struct Keyword {
+    std::string_view text;
+    Token::Type type { Token::Type::Identifier };
+};
+
+static constexpr Keyword keywords[] = {
     { "let", Token::Type::Let },
     { "null", Token::Type::Null },
     { "true", Token::Type::True },
@@ -21,23 +64,134 @@ const std::unordered_map<std::string_view, Token::Type> Lexer::keywords = {
     { "print", Token::Type::Print }
 };
 
-Lexer::Lexer(const std::string& code)
+static constexpr size_t MinKeywordLength = 2;
+static constexpr size_t MaxKeywordLength = 8;
+
+// Collision free over the keywords above, checked below. Only called on
+// text of at least MinKeywordLength characters.
+static constexpr size_t keywordHash(std::string_view text)
+{
+    return (text.size() + static_cast<unsigned char>(text[0]) + 9 * static_cast<unsigned char>(text[1])) & 31;
+}
+
+static constexpr std::array<Keyword, 32> makeKeywordTable()
+{
+    std::array<Keyword, 32> table {};
+    for (const auto& keyword : keywords)
+        table[keywordHash(keyword.text)] = keyword;
+    return table;
+}
+
+static constexpr std::array<Keyword, 32> keywordTable = makeKeywordTable();
+
+static constexpr bool keywordHashIsPerfect()
+{
+    for (const auto& keyword : keywords) {
+        if (keyword.text.size() < MinKeywordLength || keyword.text.size() > MaxKeywordLength
+            || keywordTable[keywordHash(keyword.text)].text != keyword.text)
+            return false;
+    }
+    return true;
+}
+
+static_assert(keywordHashIsPerfect(), "Keywords collide in keywordTable, pick another keywordHash");
+
+static Token::Type identifierType(std::string_view text)
+{
+    if (text.size() < MinKeywordLength || text.size() > MaxKeywordLength)
+        return Token::Type::Identifier;
+    const Keyword& keyword = keywordTable[keywordHash(text)];
+    return keyword.text == text ? keyword.type : Token::Type::Identifier;
+}
+
+// Index of the first '"' or newline at or after start, the size of code if
+// there is none.
+static size_t findQuoteOrNewline(std::string_view code, size_t start)
+{
+    size_t i = start;
+#ifdef __SSE2__
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i newline = _mm_set1_epi8('\n');
+    for (; i + 16 <= code.size(); i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code.data() + i));
+        unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, newline)));
+        if (mask)
+            return i + __builtin_ctz(mask);
+    }
+#endif
+    for (; i < code.size(); ++i) {
+        if (code[i] == '"' || code[i] == '\n')
+            return i;
+    }
+    return code.size();
+}
+
+Lexer::Lexer(std::string_view code)
     : m_code(code)
     , m_start(0)
     , m_current(0)
     , m_line(1)
     , m_lineBegin(0)
+{
+    if (m_code.size() > UINT32_MAX) {
+        error(1, 1, "Source too large.");
+        m_code = {};
+    }
+}
+
+Lexer::Lexer(std::istream& input)
+    : m_input(&input)
+    , m_start(0)
+    , m_current(0)
+    , m_line(1)
+    , m_lineBegin(0)
 {
 }
 
 std::vector<Token> Lexer::lexTokens()
 {
+    std::vector<Token> tokens;
+    // Typical code has a token every few bytes.
+    tokens.reserve(m_code.size() / 4 + 1);
+    while (!atEnd()) {
+        m_lexed = false;
+        lexNextToken();
+        if (m_lexed)
+            tokens.push_back(m_token);
+    }
+
+    tokens.push_back(Token(Token::Type::Eof, m_base + m_current, 0, m_line, getTokenColumn()));
+
+    return tokens;
+}
+
+Token Lexer::next()
+{
+    m_lexed = false;
+    while (!m_lexed) {
+        if (atEnd())
+            return Token(Token::Type::Eof, m_base + m_current, 0, m_line, getTokenColumn());
+        lexNextToken();
+    }
+    return m_token;
+}
+
+void Lexer::skipRest()
+{
+    retain(SIZE_MAX);
     while (!atEnd())
         lexNextToken();
+}
 
-    m_tokens.push_back(Token(Token::Type::Eof, "", m_line, getTokenColumn()));
+void Lexer::retain(size_t offset)
+{
+    m_retain = offset;
+}
 
-    return m_tokens;
+std::string_view Lexer::lexeme(const Token& token) const
+{
+    assert(token.offset() >= m_base);
+    return m_code.substr(token.offset() - m_base, token.length());
 }
 
 void Lexer::lexNextToken()
@@ -145,40 +299,68 @@ void Lexer::lexNextToken()
         lexString();
         break;
     default:
-        if (std::isdigit(c)) {
+        if (is(c, Digit)) {
             lexNumber();
             break;
         }
-        if (std::isalpha(c)) {
+        if (is(c, Alpha)) {
             lexIdentifier();
             break;
         }
 
         error(m_line, getTokenColumn(),
-            "Unexpected token '" + getTokenString() + "'.");
+            "Unexpected token '" + std::string(getTokenString()) + "'.");
         break;
     }
 }
 
-bool Lexer::atEnd() const
+// Reads the next chunk of the input stream, dropping the source before
+// both the retained offset and the token being lexed.
+bool Lexer::fill()
 {
-    return m_current >= m_code.size();
+    if (!m_input || !*m_input)
+        return false;
+
+    size_t discard = std::min(m_start, m_retain > m_base ? m_retain - m_base : 0);
+    m_buffer.erase(0, discard);
+    m_base += discard;
+    m_start -= discard;
+    m_current -= discard;
+
+    size_t size = m_buffer.size();
+    m_buffer.resize(size + ChunkSize);
+    m_input->read(&m_buffer[size], ChunkSize);
+    m_buffer.resize(size + m_input->gcount());
+    m_code = m_buffer;
+    if (m_base + m_code.size() > UINT32_MAX) {
+        error(m_line, getTokenColumn(), "Source too large.");
+        m_input = nullptr;
+        return false;
+    }
+    return m_input->gcount() > 0;
 }
 
-char Lexer::peek() const
+bool Lexer::atEnd()
+{
+    return m_current >= m_code.size() && !fill();
+}
+
+char Lexer::peek()
 {
     if (atEnd())
         return '\0';
 
-    return m_code.at(m_current);
+    return m_code[m_current];
 }
 
-char Lexer::peekSecond() const
+char Lexer::peekSecond()
 {
-    if (m_current + 1 >= m_code.size())
-        return '\0';
+    while (m_current + 1 >= m_code.size()) {
+        if (!fill())
+            return '\0';
+    }
 
-    return m_code.at(m_current + 1);
+    return m_code[m_current + 1];
 }
 
 char Lexer::advance()
@@ -186,14 +368,14 @@ char Lexer::advance()
     if (atEnd())
         return '\0';
 
-    return m_code.at(m_current++);
+    return m_code[m_current++];
 }
 
 bool Lexer::match(char expected)
 {
     if (atEnd())
         return false;
-    if (m_code.at(m_current) != expected)
+    if (m_code[m_current] != expected)
         return false;
 
     advance();
@@ -202,49 +384,81 @@ bool Lexer::match(char expected)
 
 void Lexer::addToken(Token::Type type)
 {
-    m_tokens.push_back(Token(type, getTokenString(),
-        m_line, getTokenColumn()));
+    m_token = Token(type, m_base + m_start, m_current - m_start,
+        m_line, getTokenColumn());
+    m_lexed = true;
 }
 
 void Lexer::skipWhitespaces()
 {
     for (;;) {
-        switch (peek()) {
-        case ' ':
-        case '\t':
-        case '\v':
-        case '\f':
-        case '\r':
-            advance();
-            break;
-        case '/':
-            if (peekSecond() == '/') {
-                while (peek() != '\n' && !atEnd())
-                    advance();
-            } else {
-                return;
-            }
-            break;
-        case '\n':
-            m_line++;
-            m_lineBegin = m_current + 1;
-            advance();
-            break;
-        default:
+        skipBlanks();
+        if (peek() != '/' || peekSecond() != '/')
             return;
+        for (;;) {
+            auto newline = m_code.find('\n', m_current);
+            if (newline != std::string_view::npos) {
+                m_current = newline;
+                break;
+            }
+            m_current = m_code.size();
+            if (!fill())
+                break;
         }
     }
 }
 
-void Lexer::lexString()
+void Lexer::skipBlanks()
 {
-    while (peek() != '"' && !atEnd()) {
+    if (!is(peek(), Blank | Newline))
+        return;
+#ifdef __SSE2__
+    // '\t' to '\r' are consecutive, they are the bytes whose distance to
+    // '\t' saturates to zero once four is taken off.
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i four = _mm_set1_epi8(4);
+    while (m_current + 16 <= m_code.size()) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(m_code.data() + m_current));
+        __m128i control = _mm_cmpeq_epi8(_mm_subs_epu8(_mm_sub_epi8(chunk, tab), four), _mm_setzero_si128());
+        unsigned blanks = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chunk, space), control));
+        unsigned newlines = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        unsigned length = blanks == 0xffff ? 16 : __builtin_ctz(~blanks);
+        newlines &= (1u << length) - 1;
+        if (newlines) {
+            m_line += __builtin_popcount(newlines);
+            m_lineBegin = m_base + m_current + (31 - __builtin_clz(newlines)) + 1;
+        }
+        m_current += length;
+        if (length < 16)
+            return;
+    }
+#endif
+    while (is(peek(), Blank | Newline)) {
         if (peek() == '\n') {
             m_line++;
-            m_lineBegin = m_current + 1;
+            m_lineBegin = m_base + m_current + 1;
         }
         advance();
     }
+}
+
+void Lexer::lexString()
+{
+    for (;;) {
+        m_current = findQuoteOrNewline(m_code, m_current);
+        if (m_current == m_code.size()) {
+            if (!fill())
+                break;
+            continue;
+        }
+        if (m_code[m_current] != '\n')
+            break;
+        m_line++;
+        m_lineBegin = m_base + m_current + 1;
+        m_current++;
+    }
 
     if (atEnd()) {
         error(m_line, getTokenColumn(), "Unterminated string.");
@@ -256,12 +470,12 @@ void Lexer::lexString()
 
 void Lexer::lexNumber()
 {
-    while (std::isdigit(peek()))
+    while (is(peek(), Digit))
         advance();
 
-    if (peek() == '.' && std::isdigit(peekSecond())) {
+    if (peek() == '.' && is(peekSecond(), Digit)) {
         advance();
-        while (std::isdigit(peek()))
+        while (is(peek(), Digit))
             advance();
     }
 
@@ -270,25 +484,19 @@ void Lexer::lexNumber()
 
 void Lexer::lexIdentifier()
 {
-    while (std::isalnum(peek()))
+    while (is(peek(), Alpha | Digit))
         advance();
-    try {
-        auto text = getTokenString();
-        Token::Type type = keywords.at(text);
-        addToken(type);
-    } catch (...) {
-        addToken(Token::Type::Identifier);
-    }
+    addToken(identifierType(getTokenString()));
 }
 
-std::string Lexer::getTokenString() const
+std::string_view Lexer::getTokenString() const
 {
     return m_code.substr(m_start, m_current - m_start);
 }
 
 size_t Lexer::getTokenColumn() const
 {
-    return m_start - m_lineBegin + 1;
+    return m_base + m_start - m_lineBegin + 1;
 }
 
 }
@@ -1,41 +1,63 @@
 #pragma once
 
+#include <istream>
 #include <string>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 #include "token.hpp"
 
 namespace Msl {
 
+// Lexes either a whole source held in memory or an input stream read in
+// chunks as tokens are pulled with next(). A stream is only buffered from
+// the offset passed to retain(), so lexing it takes bounded memory.
 class Lexer {
 public:
-    Lexer(const std::string& code);
+    // The tokens point into code, which has to outlive them.
+    Lexer(std::string_view code);
+    Lexer(std::istream& input);
     std::vector<Token> lexTokens();
+    // Returns Eof tokens once the input is exhausted.
+    Token next();
+    // Lexes the rest of the input only to report its errors.
+    void skipRest();
+    // Source text before offset may be dropped from the buffer.
+    void retain(size_t offset);
+    std::string_view lexeme(const Token& token) const;
 
 private:
-    static const std::unordered_map<std::string_view, Token::Type> keywords;
-
-    std::string m_code;
+    static constexpr size_t ChunkSize = 64 * 1024;
+
+    std::istream* m_input { nullptr };
+    std::string m_buffer;
+    // The buffered source, m_base is the offset of its first character.
+    std::string_view m_code;
+    size_t m_base { 0 };
+    size_t m_retain { 0 };
     size_t m_start;
     size_t m_current;
     size_t m_line;
+    // Offset into the source, unlike the positions in m_code above.
     size_t m_lineBegin;
-    std::vector<Token> m_tokens;
+    Token m_token;
+    bool m_lexed { false };
 
     void lexNextToken();
-    bool atEnd() const;
-    char peek() const;
-    char peekSecond() const;
+    bool fill();
+    bool atEnd();
+    char peek();
+    char peekSecond();
     char advance();
     bool match(char expected);
     void addToken(Token::Type type);
     void skipWhitespaces();
+    void skipBlanks();
     void lexString();
     void lexNumber();
     void lexIdentifier();
     size_t getTokenColumn() const;
-    std::string getTokenString() const;
+    std::string_view getTokenString() const;
 };
 
 }
@@ -1,5 +1,11 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <new>
 #include <sstream>
 #include <vector>
 
@@ -11,30 +17,94 @@
 
 namespace Msl {
 
-static void run(const std::string& code)
-{
-    Lexer lexer(code);
-    std::vector<Token> tokens = lexer.lexTokens();
-
-    if (hadError()) {
-        return;
-    }
+struct Options {
+    Interpreter::Engine engine { Interpreter::Engine::Bytecode };
+    bool inlineCacheStats { false };
+    bool gcStats { false };
+    // Only lex the script and report the lexer's throughput.
+    bool lexBenchmark { false };
+    double gcGrowthFactor { Heap::DefaultGrowthFactor };
+    // Zero keeps full collections stop-the-world.
+    long gcPauseBudget { 0 };
+    bool gcConcurrent { false };
+    unsigned long gcThreads { 1 };
+    // Zero leaves compaction off.
+    double gcCompactThreshold { 0 };
+    // Negative keeps the heap's default, derived from the cgroup limit.
+    long heapLimit { -1 };
+};
 
-    Parser parser(tokens);
+static void run(Lexer& lexer, const Options& options)
+{
+    Parser parser(lexer);
     try {
-        Interpreter interpreter;
-        auto program = parser.parse();
-        // program->prettyPrint(0);
-        interpreter.run(program);
-        delete program;
+        Interpreter interpreter(options.engine, options.gcConcurrent);
+        interpreter.heap().growthFactor(options.gcGrowthFactor);
+        interpreter.heap().markThreads(options.gcThreads);
+        if (options.heapLimit >= 0) {
+            interpreter.heap().heapLimit(static_cast<size_t>(options.heapLimit) * 1024 * 1024);
+        }
+        if (options.gcCompactThreshold) {
+            interpreter.heap().compaction(true);
+            interpreter.heap().fragmentationThreshold(options.gcCompactThreshold);
+        }
+        if (options.gcPauseBudget) {
+            interpreter.heap().incremental(true);
+            interpreter.heap().pauseBudget(std::chrono::microseconds(options.gcPauseBudget));
+        }
+        // Owned here so that a script ending in an exception frees it too.
+        std::unique_ptr<Program> program(parser.parse());
+        // The lexer reports its errors as the parser pulls tokens.
+        if (hadError())
+            return;
+        // FlatAst(*program).prettyPrint(0);
+        interpreter.run(program.get());
+        if (options.inlineCacheStats)
+            interpreter.printInlineCacheStats(std::cerr);
+        if (options.gcStats) {
+            interpreter.heap().statistics().print(std::cerr);
+            std::cerr << "  memory: " << interpreter.heap().residentBytes() << " bytes resident, "
+                      << interpreter.heap().committedBytes() << " bytes committed, "
+                      << interpreter.heap().payloadBytes() << " bytes of cell payloads" << std::endl;
+        } else if (options.gcPauseBudget || options.gcConcurrent || options.gcThreads > 1)
+            std::cerr << "GC max pause: " << interpreter.heap().statistics().maxPause.count() << "us" << std::endl;
     } catch (ParsingException& e) {
-        error(e.token.line(), e.token.column(), e.message);
+        // Errors in the rest of the input take precedence, the parser may
+        // only have failed on the tokens a lexer error dropped.
+        lexer.skipRest();
+        if (!hadError())
+            error(e.token.line(), e.token.column(), e.message);
     } catch (RuntimeException& e) {
         std::cout << "RuntimeException: " << e.message << std::endl;
+    } catch (std::bad_alloc&) {
+        // Memory outside the heap's accounting ran out, the script ends the
+        // same way as when it hits the heap limit.
+        std::cout << "RuntimeException: Out of memory" << std::endl;
     }
 }
 
-static int runREPL()
+static int benchmarkLexer(const std::string& code)
+{
+    using Clock = std::chrono::steady_clock;
+    constexpr int Runs = 10;
+    Clock::duration best = Clock::duration::max();
+    size_t tokens = 0;
+    for (int run = 0; run < Runs && !hadError(); ++run) {
+        auto start = Clock::now();
+        Lexer lexer(code);
+        tokens = lexer.lexTokens().size();
+        best = std::min(best, Clock::now() - start);
+    }
+    if (hadError())
+        return 65;
+
+    double seconds = std::chrono::duration<double>(best).count();
+    std::cerr << "Lexed " << code.size() << " bytes into " << tokens << " tokens in "
+              << seconds * 1000 << "ms, " << code.size() / seconds / (1024 * 1024) << " MB/s" << std::endl;
+    return 0;
+}
+
+static int runREPL(const Options& options)
 {
     std::string line;
 
@@ -43,14 +113,15 @@ static int runREPL()
         std::getline(std::cin, line);
         if (std::cin.fail())
             return 1;
-        run(line);
+        Lexer lexer(line);
+        run(lexer, options);
         hadError(false);
     }
 
     return 0;
 }
 
-static int runFile(const std::string& path)
+static int runFile(const std::string& path, const Options& options)
 {
     std::ifstream file(path);
     if (!file) {
@@ -58,10 +129,13 @@ static int runFile(const std::string& path)
         return 74;
     }
 
-    std::ostringstream ss;
-    ss << file.rdbuf();
-    std::string code = ss.str();
-    run(code);
+    if (options.lexBenchmark) {
+        std::ostringstream ss;
+        ss << file.rdbuf();
+        return benchmarkLexer(ss.str());
+    }
+    Lexer lexer(file);
+    run(lexer, options);
 
     if (hadError())
         return 65;
@@ -69,18 +143,79 @@ static int runFile(const std::string& path)
     return 0;
 }
 
+static int usage()
+{
+    std::cerr << "Usage: msl [--engine=ast|vm] [--ic-stats] [--gc-stats] [--gc-growth=factor]\n"
+              << "           [--gc-pause-budget=us] [--gc-concurrent] [--gc-threads=n]\n"
+              << "           [--gc-compact=fraction] [--heap-limit=mb] [--lex-bench] [script]" << std::endl;
+    return 64;
+}
+
 }
 
 int main(int argc, char* argv[])
 {
-    if (argc == 1) {
-        return Msl::runREPL();
-    } else if (argc == 2) {
-        return Msl::runFile(argv[1]);
-    } else {
-        std::cerr << "Usage: msl <script>" << std::endl;
-        return 64;
+    Msl::Options options;
+    std::string path;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--engine=ast") {
+            options.engine = Msl::Interpreter::Engine::Ast;
+        } else if (arg == "--engine=vm") {
+            options.engine = Msl::Interpreter::Engine::Bytecode;
+        } else if (arg == "--ic-stats") {
+            options.inlineCacheStats = true;
+        } else if (arg == "--gc-stats") {
+            options.gcStats = true;
+        } else if (arg == "--lex-bench") {
+            options.lexBenchmark = true;
+        } else if (arg.rfind("--gc-growth=", 0) == 0) {
+            char* end;
+            const char* factor = arg.c_str() + std::strlen("--gc-growth=");
+            options.gcGrowthFactor = std::strtod(factor, &end);
+            if (end == factor || *end || !(options.gcGrowthFactor > 1.0)) {
+                return Msl::usage();
+            }
+        } else if (arg.rfind("--gc-threads=", 0) == 0) {
+            char* end;
+            const char* count = arg.c_str() + std::strlen("--gc-threads=");
+            options.gcThreads = std::strtoul(count, &end, 10);
+            if (end == count || *end || !options.gcThreads) {
+                return Msl::usage();
+            }
+        } else if (arg.rfind("--gc-compact=", 0) == 0) {
+            char* end;
+            const char* fraction = arg.c_str() + std::strlen("--gc-compact=");
+            options.gcCompactThreshold = std::strtod(fraction, &end);
+            if (end == fraction || *end || !(options.gcCompactThreshold > 0.0 && options.gcCompactThreshold < 1.0)) {
+                return Msl::usage();
+            }
+        } else if (arg.rfind("--heap-limit=", 0) == 0) {
+            char* end;
+            const char* limit = arg.c_str() + std::strlen("--heap-limit=");
+            options.heapLimit = std::strtol(limit, &end, 10);
+            if (end == limit || *end || options.heapLimit < 0) {
+                return Msl::usage();
+            }
+        } else if (arg == "--gc-concurrent") {
+            options.gcConcurrent = true;
+        } else if (arg.rfind("--gc-pause-budget=", 0) == 0) {
+            char* end;
+            const char* budget = arg.c_str() + std::strlen("--gc-pause-budget=");
+            options.gcPauseBudget = std::strtol(budget, &end, 10);
+            if (end == budget || *end || options.gcPauseBudget <= 0) {
+                return Msl::usage();
+            }
+        } else if (arg.rfind("--", 0) == 0 || !path.empty()) {
+            return Msl::usage();
+        } else {
+            path = arg;
+        }
     }
 
-    return EXIT_SUCCESS;
+    if (path.empty()) {
+        return Msl::runREPL(options);
+    }
+    return Msl::runFile(path, options);
 }
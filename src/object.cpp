@@ -1,12 +1,12 @@
 #include "object.hpp"
 
-#include <iostream>
-#include <stdexcept>
+#include <cassert>
 
 namespace Msl {
 
-Object::Object()
-    : m_marked(false)
+Object::Object(Shape* shape)
+    : m_shape(shape)
+    , m_slots(shape ? shape->size() : 0)
 {
 }
 
@@ -14,41 +14,103 @@ Object::~Object()
 {
 }
 
-Value Object::get(const std::string& key) const
+Value Object::get(String* key) const
 {
-    Value ret;
-    try {
-        ret = m_properties.at(key);
-    } catch (const std::out_of_range& e) {
-        ret = Value();
+    if (!m_shape) {
+        return Value();
     }
-    return ret;
+    uint32_t offset = m_shape->offset(key);
+    if (offset == Shape::NotFound) {
+        return Value();
+    }
+    return m_slots[offset];
+}
+
+Value Object::set(String* key, Value value)
+{
+    assert(m_shape);
+    uint32_t offset = m_shape->offset(key);
+    if (offset == Shape::NotFound) {
+        m_shape = m_shape->addProperty(key);
+        append(m_slots, value);
+    } else {
+        write(m_slots[offset], value);
+    }
+    return value;
+}
+
+Value Object::get(String* key, InlineCache& cache) const
+{
+    uint32_t offset = cache.offset(m_shape);
+    if (offset == Shape::NotFound) {
+        offset = m_shape->offset(key);
+        if (offset == Shape::NotFound) {
+            return Value();
+        }
+        cache.update(m_shape, offset);
+    }
+    return m_slots[offset];
 }
 
-Value Object::set(const std::string& key, Value value)
+Value Object::set(String* key, Value value, InlineCache& cache)
 {
-    m_properties.insert_or_assign(key, value);
+    uint32_t offset = cache.offset(m_shape);
+    if (offset == Shape::NotFound) {
+        offset = m_shape->offset(key);
+        if (offset == Shape::NotFound) {
+            return set(key, value);
+        }
+        cache.update(m_shape, offset);
+    }
+    write(m_slots[offset], value);
     return value;
 }
 
-const std::unordered_map<std::string, Value>& Object::properties() const
+Shape* Object::shape() const
+{
+    return m_shape;
+}
+
+const std::vector<Value>& Object::slots() const
 {
-    return m_properties;
+    return m_slots;
+}
+
+Value Object::slot(uint32_t offset) const
+{
+    return m_slots[offset];
+}
+
+void Object::slot(uint32_t offset, Value value)
+{
+    write(m_slots[offset], value);
 }
 
 bool Object::isEmpty() const
 {
-    return m_properties.size() ? true : false;
+    return m_slots.empty();
+}
+
+void Object::trace(Visitor& visitor)
+{
+    for (auto& value : m_slots) {
+        visitor.visit(value);
+    }
+}
+
+size_t Object::cellSize() const
+{
+    return sizeof(Object);
 }
 
-bool Object::marked() const
+size_t Object::payloadSize() const
 {
-    return m_marked;
+    return m_slots.capacity() * sizeof(Value);
 }
 
-void Object::marked(bool marked)
+CellType Object::cellType() const
 {
-    m_marked = marked;
+    return CellType::Object;
 }
 
 }
@@ -1,26 +1,36 @@
 #pragma once
 
+#include "cell.hpp"
+#include "inlinecache.hpp"
+#include "shape.hpp"
 #include "value.hpp"
 
-#include <unordered_map>
+#include <vector>
 
 namespace Msl {
 
-class Object
-{
+class Object : public Cell {
 public:
-    Object();
+    // Arrays and functions carry no named properties and pass a null shape.
+    explicit Object(Shape* shape);
     virtual ~Object();
-    Value get(const std::string& key) const;
-    Value set(const std::string& key, Value value);
-    const std::unordered_map<std::string, Value>& properties() const;
+    Value get(String* key) const;
+    Value set(String* key, Value value);
+    Value get(String* key, InlineCache& cache) const;
+    Value set(String* key, Value value, InlineCache& cache);
+    Shape* shape() const;
+    const std::vector<Value>& slots() const;
+    Value slot(uint32_t offset) const;
+    void slot(uint32_t offset, Value value);
     bool isEmpty() const;
-    bool marked() const;
-    void marked(bool marked);
+    virtual void trace(Visitor& visitor) override;
+    virtual size_t cellSize() const override;
+    virtual size_t payloadSize() const override;
+    virtual CellType cellType() const override;
 
 private:
-    bool m_marked { false };
-    std::unordered_map<std::string, Msl::Value> m_properties;
+    Shape* m_shape;
+    std::vector<Value> m_slots;
 };
 
 }
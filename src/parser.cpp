@@ -3,13 +3,15 @@
 #include "exceptions.hpp"
 #include "token.hpp"
 
+#include <charconv>
 #include <cstdarg>
 #include <iostream>
 
 namespace Msl {
 
-Parser::Parser(std::vector<Token>& tokens)
-    : m_tokens(std::move(tokens))
+Parser::Parser(Lexer& lexer)
+    : m_tokens(lexer)
+    , m_arena(std::make_unique<AstArena>())
 {
 }
 
@@ -27,7 +29,8 @@ Program* Parser::parseProgram()
         statements.push_back(declaration);
     }
 
-    return new Program(std::move(statements));
+    auto body = m_arena->list(statements);
+    return new Program(body, std::move(m_arena));
 }
 
 Statement* Parser::parseDeclaration()
@@ -49,31 +52,31 @@ Statement* Parser::parseVariableDeclaration()
 
     do {
         auto name = consume(Token::Type::Identifier, "Expected variable name.");
-        auto identifier = new Identifier(name.str());
+        auto identifier = m_arena->make<Identifier>(m_arena->string(lexeme(name)));
         Expression* init = nullptr;
         if (match(1, Token::Type::Equal)) {
             init = parseExpression();
         }
         if (init)
-            declarators.push_back(new VariableDeclarator(identifier, init));
+            declarators.push_back(m_arena->make<VariableDeclarator>(identifier, init));
         else
-            declarators.push_back(new VariableDeclarator(identifier));
+            declarators.push_back(m_arena->make<VariableDeclarator>(identifier, m_arena->make<Literal>(Value())));
     } while (match(1, Token::Type::Comma));
 
     consume(Token::Type::SemiColon, "Expected ';' after declaration.");
 
-    return new VariableDeclaration(std::move(declarators));
+    return m_arena->make<VariableDeclaration>(m_arena->list(declarators));
 }
 
 Statement* Parser::parseStatement()
 {
     if (match(1, Token::Type::Continue)) {
         consume(Token::Type::SemiColon, "Expected ';' after continue statement.");
-        return new ContinueStatement();
+        return m_arena->make<ContinueStatement>();
     }
     if (match(1, Token::Type::Break)) {
         consume(Token::Type::SemiColon, "Expected ';' after break statement.");
-        return new BreakStatement();
+        return m_arena->make<BreakStatement>();
     }
     if (match(1, Token::Type::Do))
         return parseDoWhileStatement();
@@ -98,7 +101,7 @@ Statement* Parser::parseReturnStatement()
     if (!check(Token::Type::SemiColon))
         argument = parseExpression();
     consume(Token::Type::SemiColon, "Expected ';' after return statement.");
-    return new ReturnStatement(argument);
+    return m_arena->make<ReturnStatement>(argument);
 }
 
 Statement* Parser::parseDoWhileStatement()
@@ -110,7 +113,7 @@ Statement* Parser::parseDoWhileStatement()
     consume(Token::Type::CloseParen, "Expected ')' after do while loop condition.");
     consume(Token::Type::SemiColon, "Expected ';' after do while loop.");
 
-    return new DoWhileLoopStatement(condition, body);
+    return m_arena->make<DoWhileLoopStatement>(condition, body);
 }
 
 Statement* Parser::parseWhileStatement()
@@ -119,7 +122,7 @@ Statement* Parser::parseWhileStatement()
     auto condition = parseExpression();
     consume(Token::Type::CloseParen, "Expected ')' after while loop condition .");
     auto body = parseStatement();
-    return new WhileLoopStatement(condition, body);
+    return m_arena->make<WhileLoopStatement>(condition, body);
 }
 
 Statement* Parser::parseForStatement()
@@ -149,7 +152,7 @@ Statement* Parser::parseForStatement()
 
     auto body = parseStatement();
 
-    return new ForLoopStatement(init, condition, increment, body);
+    return m_arena->make<ForLoopStatement>(init, condition, increment, body);
 }
 
 Statement* Parser::parseIfStatement()
@@ -164,9 +167,9 @@ Statement* Parser::parseIfStatement()
         elseBranch = parseStatement();
 
     if (elseBranch)
-        return new IfElseStatement(condition, ifBranch, elseBranch);
+        return m_arena->make<IfElseStatement>(condition, ifBranch, elseBranch);
 
-    return new IfElseStatement(condition, ifBranch);
+    return m_arena->make<IfElseStatement>(condition, ifBranch);
 }
 
 Statement* Parser::parseBlockStatement()
@@ -176,21 +179,21 @@ Statement* Parser::parseBlockStatement()
         statements.push_back(parseDeclaration());
     }
     consume(Token::Type::CloseBrace, "Expected '}' after block.");
-    return new BlockStatement(std::move(statements));
+    return m_arena->make<BlockStatement>(m_arena->list(statements));
 }
 
 Statement* Parser::parsePrintStatement()
 {
     auto argument = parseExpression();
     consume(Token::Type::SemiColon, "Expected ';' after print argument.");
-    return new PrintStatement(argument);
+    return m_arena->make<PrintStatement>(argument);
 }
 
 Statement* Parser::parseExpressionStatement()
 {
     auto expression = parseExpression();
     consume(Token::Type::SemiColon, "Exected ';' after expression");
-    return new ExpressionStatement(expression);
+    return m_arena->make<ExpressionStatement>(expression);
 }
 
 Expression* Parser::parseExpression()
@@ -230,14 +233,14 @@ Expression* Parser::parseAssignment()
         }
         auto right = parseAssignment();
 
-        if (expression->isIdentifier())
-            return new AssignmentExpression(op,
+        if (expression->kind() == Ast::Kind::Identifier)
+            return m_arena->make<AssignmentExpression>(op,
                 static_cast<Identifier*>(expression), right);
-        if (expression->isMemberExpression())
-            return new AssignmentExpression(op,
+        if (expression->kind() == Ast::Kind::MemberExpression)
+            return m_arena->make<AssignmentExpression>(op,
                 static_cast<MemberExpression*>(expression), right);
-        if (expression->isArrayMemberExpression())
-            return new AssignmentExpression(op,
+        if (expression->kind() == Ast::Kind::ArrayMemberExpression)
+            return m_arena->make<AssignmentExpression>(op,
                 static_cast<ArrayMemberExpression*>(expression), right);
 
         throw ParsingException(operatorToken, "Invalid assignment target");
@@ -252,7 +255,7 @@ Expression* Parser::parseOr()
 
     while (match(1, Token::Type::Or)) {
         auto right = parseAnd();
-        expression = new LogicalExpression(LogicalExpression::Operator::Or,
+        expression = m_arena->make<LogicalExpression>(LogicalExpression::Operator::Or,
             expression, right);
     }
     return expression;
@@ -264,7 +267,7 @@ Expression* Parser::parseAnd()
 
     while (match(1, Token::Type::And)) {
         auto right = parseEquality();
-        expression = new LogicalExpression(LogicalExpression::Operator::And,
+        expression = m_arena->make<LogicalExpression>(LogicalExpression::Operator::And,
             expression, right);
     }
     return expression;
@@ -279,7 +282,7 @@ Expression* Parser::parseEquality()
             ? BinaryExpression::Operator::Equals
             : BinaryExpression::Operator::Inequals;
         auto right = parseComparison();
-        expr = new BinaryExpression(op, expr, right);
+        expr = m_arena->make<BinaryExpression>(op, expr, right);
     }
 
     return expr;
@@ -308,7 +311,7 @@ Expression* Parser::parseComparison()
             assert(false);
         }
         auto right = parseTerm();
-        expr = new BinaryExpression(op, expr, right);
+        expr = m_arena->make<BinaryExpression>(op, expr, right);
     }
 
     return expr;
@@ -322,7 +325,7 @@ Expression* Parser::parseTerm()
             ? BinaryExpression::Operator::Addition
             : BinaryExpression::Operator::Subtraction;
         auto right = parseFactor();
-        expr = new BinaryExpression(op, expr, right);
+        expr = m_arena->make<BinaryExpression>(op, expr, right);
     }
 
     return expr;
@@ -348,7 +351,7 @@ Expression* Parser::parseFactor()
             assert(false);
         }
         auto right = parseUnary();
-        expr = new BinaryExpression(op, expr, right);
+        expr = m_arena->make<BinaryExpression>(op, expr, right);
     }
 
     return expr;
@@ -359,26 +362,26 @@ Expression* Parser::parseUnary()
 
     if (match(1, Token::Type::Bang)) {
         auto right = parseUnary();
-        return new UnaryExpression(UnaryExpression::Operator::Not, right);
+        return m_arena->make<UnaryExpression>(UnaryExpression::Operator::Not, right);
     }
 
     if (match(1, Token::Type::Minus)) {
         auto right = parseUnary();
-        return new UnaryExpression(UnaryExpression::Operator::Minus, right);
+        return m_arena->make<UnaryExpression>(UnaryExpression::Operator::Minus, right);
     }
     if (match(1, Token::Type::Plus)) {
         auto right = parseUnary();
-        return new UnaryExpression(UnaryExpression::Operator::Plus, right);
+        return m_arena->make<UnaryExpression>(UnaryExpression::Operator::Plus, right);
     }
 
     if (match(1, Token::Type::PlusPlus)) {
         auto right = parseUnary();
-        return new UpdateExpression(UpdateExpression::Operation::Increment, true, right);
+        return m_arena->make<UpdateExpression>(UpdateExpression::Operation::Increment, true, right);
     }
 
     if (match(1, Token::Type::MinusMinus)) {
         auto right = parseUnary();
-        return new UpdateExpression(UpdateExpression::Operation::Decrement, true, right);
+        return m_arena->make<UpdateExpression>(UpdateExpression::Operation::Decrement, true, right);
     }
 
     return parseFunctionCallOrMember();
@@ -397,9 +400,9 @@ Expression* Parser::parseFunctionCallOrMember()
             expression = parseArrayMember(expression);
 
         } else if (match(1, Token::Type::PlusPlus)) {
-            expression = new UpdateExpression(UpdateExpression::Operation::Increment, false, expression);
+            expression = m_arena->make<UpdateExpression>(UpdateExpression::Operation::Increment, false, expression);
         } else if (match(1, Token::Type::MinusMinus)) {
-            expression = new UpdateExpression(UpdateExpression::Operation::Decrement, false, expression);
+            expression = m_arena->make<UpdateExpression>(UpdateExpression::Operation::Decrement, false, expression);
         } else {
             break;
         }
@@ -417,43 +420,45 @@ Expression* Parser::parseFunctionCall(Expression* expression)
         } while (match(1, Token::Type::Comma));
     }
     consume(Token::Type::CloseParen, "Expected ')' after function  arguments");
-    return new CallExpression(expression, args);
+    return m_arena->make<CallExpression>(expression, m_arena->list(args));
 }
 
 Expression* Parser::parseObjectMember(Expression* expression)
 {
     auto identifier = consume(Token::Type::Identifier,
         "Expected identifier after . to access property.");
-    auto property = new Identifier(identifier.str());
-    return new MemberExpression(expression, property);
+    auto property = m_arena->make<Identifier>(m_arena->string(lexeme(identifier)));
+    return m_arena->make<MemberExpression>(expression, property, identifier.line());
 }
 
 Expression* Parser::parseArrayMember(Expression* expression)
 {
     auto index = parseExpression();
     consume(Token::Type::CloseBracket, "Expected ']' after array index");
-    return new ArrayMemberExpression(expression, index);
+    return m_arena->make<ArrayMemberExpression>(expression, index);
 }
 
 Expression* Parser::parsePrimary()
 {
     if (match(1, Token::Type::Null))
-        return new Literal(Value());
+        return m_arena->make<Literal>(Value());
     if (match(1, Token::Type::False))
-        return new Literal(Value(false));
+        return m_arena->make<Literal>(Value(false));
     if (match(1, Token::Type::True))
-        return new Literal(Value(true));
-    if (match(1, Token::Type::NumberLiteral))
-        return new Literal(Value(std::stod(previous().str())));
+        return m_arena->make<Literal>(Value(true));
+    if (match(1, Token::Type::NumberLiteral)) {
+        auto text = lexeme(previous());
+        double number = 0;
+        std::from_chars(text.data(), text.data() + text.size(), number);
+        return m_arena->make<Literal>(Value(number));
+    }
     if (match(1, Token::Type::StringLiteral)) {
-        auto str = previous().str();
-        assert(str.size() >= 2);
-        str.pop_back();
-        str.erase(str.begin());
-        return new Literal(Value(str));
+        auto text = lexeme(previous());
+        assert(text.size() >= 2);
+        return m_arena->make<Literal>(m_arena->string(text.substr(1, text.size() - 2)));
     }
     if (match(1, Token::Type::Identifier))
-        return new Identifier(previous().str());
+        return m_arena->make<Identifier>(m_arena->string(lexeme(previous())));
 
     if (match(1, Token::Type::OpenParen)) {
         if ((peek(0).type() == Token::Type::CloseParen)
@@ -488,7 +493,7 @@ Expression* Parser::parseArrayExpression()
     }
     consume(Token::Type::CloseBracket, "Expceted ']' after array elements.");
 
-    return new ArrayExpression(elements);
+    return m_arena->make<ArrayExpression>(m_arena->list(elements));
 }
 
 Expression* Parser::parseObjectExpression()
@@ -498,16 +503,16 @@ Expression* Parser::parseObjectExpression()
         do {
             auto tok = consume(Token::Type::Identifier,
                 "Expected property identifier name in object expression");
-            auto name = new Identifier(tok.str());
+            auto name = m_arena->make<Identifier>(m_arena->string(lexeme(tok)));
             consume(Token::Type::Colon,
                 "Expected ':' after proprety name in object expression");
             auto init = parseExpression();
-            properties.push_back(new ObjectProperty(name, init));
+            properties.push_back(m_arena->make<ObjectProperty>(name, init));
         } while (match(1, Token::Type::Comma));
     }
     consume(Token::Type::CloseBrace, "Expceted '}' after object expression.");
 
-    return new ObjectExpression(properties);
+    return m_arena->make<ObjectExpression>(m_arena->list(properties));
 }
 
 Expression* Parser::parseFunctionExpression()
@@ -518,14 +523,14 @@ Expression* Parser::parseFunctionExpression()
         do {
             auto param = consume(Token::Type::Identifier,
                 "Expected parameter name after '(' in function expression");
-            params.push_back(new Identifier(param.str()));
+            params.push_back(m_arena->make<Identifier>(m_arena->string(lexeme(param))));
         } while (match(1, Token::Type::Comma));
     }
 
     consume(Token::Type::CloseParen, "Expected ')' after function params");
     consume(Token::Type::OpenBrace, "Expected block after function params");
-    auto* body = dynamic_cast<BlockStatement*>(parseBlockStatement());
-    return new FunctionExpression(params, body);
+    auto* body = static_cast<BlockStatement*>(parseBlockStatement());
+    return m_arena->make<FunctionExpression>(m_arena->list(params), body);
 }
 
 void Parser::synchronize()
@@ -575,10 +580,10 @@ bool Parser::check(Token::Type type)
     return peek(0).type() == type;
 }
 
-Token Parser::advance()
+const Token& Parser::advance()
 {
     if (!isAtEnd())
-        current++;
+        m_tokens.advance();
     return previous();
 }
 
@@ -587,24 +592,26 @@ bool Parser::isAtEnd()
     return peek(0).type() == Token::Type::Eof;
 }
 
-Token Parser::peek(size_t i)
+const Token& Parser::peek(size_t i)
 {
-    if (current + i > m_tokens.size())
-        return m_tokens.back();
-
-    return m_tokens.at(current + i);
+    return m_tokens.peek(i);
 }
 
-Token Parser::previous()
+const Token& Parser::previous()
 {
-    return m_tokens.at(current - 1);
+    return m_tokens.previous();
 }
 
-Token Parser::consume(Token::Type type, const std::string& message)
+const Token& Parser::consume(Token::Type type, const std::string& message)
 {
     if (check(type))
         return advance();
     throw ParsingException(peek(0), message);
 }
 
+std::string_view Parser::lexeme(const Token& token) const
+{
+    return m_tokens.lexeme(token);
+}
+
 }
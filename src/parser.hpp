@@ -2,7 +2,11 @@
 
 #include "ast.hpp"
 #include "token.hpp"
+#include "tokenstream.hpp"
 
+#include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
 namespace Msl {
@@ -10,7 +14,8 @@ namespace Msl {
 class Parser
 {
 public:
-    Parser(std::vector<Token>& tokens);
+    // Pulls its tokens from lexer as it goes.
+    Parser(Lexer& lexer);
     Program* parse();
     Program* parseProgram();
     Statement* parseStatement();
@@ -48,12 +53,14 @@ private:
     bool match(size_t count...);
     bool check(Token::Type type);
     bool isAtEnd();
-    Token advance();
-    Token peek(size_t i);
-    Token previous();
-    Token consume(Token::Type type, const std::string& message);
-    size_t current { 0 };
-    std::vector<Token> m_tokens;
+    const Token& advance();
+    const Token& peek(size_t i);
+    const Token& previous();
+    const Token& consume(Token::Type type, const std::string& message);
+    std::string_view lexeme(const Token& token) const;
+    TokenStream m_tokens;
+    // Handed to the Program once parsing succeeds.
+    std::unique_ptr<AstArena> m_arena;
 };
 
 }
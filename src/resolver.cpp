@@ -0,0 +1,145 @@
+#include "resolver.hpp"
+#include "exceptions.hpp"
+#include "heap.hpp"
+
+#include <cassert>
+
+namespace Msl {
+
+Resolver::Resolver(Heap& heap)
+    : m_heap(heap)
+{
+}
+
+void Resolver::resolve(Program* program, const std::vector<std::string>& globals)
+{
+    m_scopes.clear();
+    m_loopDepths = { 0 };
+    m_functionScopes = { 0 };
+    m_propertySites.clear();
+    beginScope();
+    for (const auto& global : globals) {
+        declare(global);
+    }
+    program->resolve(*this);
+    program->slotCount(endScope());
+}
+
+void Resolver::beginScope()
+{
+    m_scopes.push_back({});
+}
+
+size_t Resolver::endScope()
+{
+    size_t slotCount = m_scopes.back().size();
+    m_scopes.pop_back();
+    return slotCount;
+}
+
+void Resolver::beginFunction()
+{
+    m_functionScopes.push_back(m_scopes.size());
+    beginScope();
+    m_loopDepths.push_back(0);
+}
+
+size_t Resolver::endFunction()
+{
+    m_loopDepths.pop_back();
+    m_functionScopes.pop_back();
+    return endScope();
+}
+
+void Resolver::beginLoop()
+{
+    m_loopDepths.back()++;
+}
+
+void Resolver::endLoop()
+{
+    m_loopDepths.back()--;
+}
+
+void Resolver::jump(const std::string& keyword)
+{
+    if (!m_loopDepths.back()) {
+        throw RuntimeException("'" + keyword + "' outside of a loop");
+    }
+}
+
+void Resolver::declare(std::string_view name, bool defined)
+{
+    auto& scope = m_scopes.back();
+    uint32_t slot = scope.size();
+    auto res = scope.emplace(name, Binding { slot, defined });
+    if (!res.second) {
+        throw RuntimeException("Variable already exists");
+    }
+}
+
+void Resolver::define(std::string_view name)
+{
+    auto it = m_scopes.back().find(name);
+    assert(it != m_scopes.back().end());
+    it->second.defined = true;
+}
+
+void Resolver::hoist(const AstList<Statement*>& statements)
+{
+    for (auto& statement : statements) {
+        hoist(statement);
+    }
+}
+
+void Resolver::hoist(Statement* statement)
+{
+    if (statement->kind() != Ast::Kind::VariableDeclaration)
+        return;
+    auto declaration = static_cast<VariableDeclaration*>(statement);
+    for (auto& declarator : declaration->declarators()) {
+        declare(declarator->name()->name(), false);
+    }
+}
+
+String* Resolver::intern(std::string_view string)
+{
+    return m_heap.intern(string);
+}
+
+Shape* Resolver::emptyShape() const
+{
+    return m_heap.emptyShape();
+}
+
+void Resolver::addPropertySite(const MemberExpression* site)
+{
+    m_propertySites.push_back(site);
+}
+
+const std::vector<const MemberExpression*>& Resolver::propertySites() const
+{
+    return m_propertySites;
+}
+
+void Resolver::bind(Identifier* identifier)
+{
+    uint32_t depth = 0;
+    size_t functionScope = m_functionScopes.back();
+    for (size_t i = m_scopes.size(); i--;) {
+        auto& scope = m_scopes[i];
+        auto it = scope.find(identifier->name());
+        // Enclosing functions may call this one once their hoisted
+        // bindings are set, a use ahead of the declaration in the same
+        // function never sees it.
+        if (it != scope.end() && (it->second.defined || i < functionScope)) {
+            identifier->bind(depth, it->second.slot);
+            return;
+        }
+        if (!scope.empty()) {
+            depth++;
+        }
+    }
+}
+
+}
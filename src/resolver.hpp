@@ -0,0 +1,59 @@
+#pragma once
+
+#include "ast.hpp"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace Msl {
+
+// Binds every variable reference to a (depth, slot) pair before the program
+// runs. Depth counts the materialized environments between a use and its
+// declaration, scopes that declare nothing get no environment at runtime
+// and are skipped.
+//
+// `let` declarations are hoisted to the top of their scope so functions can
+// refer to bindings declared after them. Code of the same function that runs
+// before a declaration still resolves the name to the enclosing scopes.
+class Resolver {
+public:
+    explicit Resolver(Heap& heap);
+    void resolve(Program* program, const std::vector<std::string>& globals);
+
+    void beginScope();
+    size_t endScope();
+    void beginFunction();
+    size_t endFunction();
+    void beginLoop();
+    void endLoop();
+    void jump(const std::string& keyword);
+    void declare(std::string_view name, bool defined = true);
+    void define(std::string_view name);
+    void hoist(const AstList<Statement*>& statements);
+    void hoist(Statement* statement);
+    void bind(Identifier* identifier);
+    String* intern(std::string_view string);
+    Shape* emptyShape() const;
+    void addPropertySite(const MemberExpression* site);
+    const std::vector<const MemberExpression*>& propertySites() const;
+
+private:
+    struct Binding {
+        uint32_t slot;
+        // False while a hoisted declaration has not been reached.
+        bool defined;
+    };
+
+    Heap& m_heap;
+    // Keyed by views of the AST's names and of the globals being resolved.
+    std::vector<std::unordered_map<std::string_view, Binding>> m_scopes;
+    // Loop nesting of each function being resolved, innermost last.
+    std::vector<size_t> m_loopDepths;
+    // Index in m_scopes of the outermost scope of each function.
+    std::vector<size_t> m_functionScopes;
+    std::vector<const MemberExpression*> m_propertySites;
+};
+
+}
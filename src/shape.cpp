@@ -0,0 +1,48 @@
+#include "shape.hpp"
+
+namespace Msl {
+
+Shape::Shape()
+{
+}
+
+Shape::Shape(const Shape& parent, String* key)
+    : m_keys(parent.m_keys)
+    , m_offsets(parent.m_offsets)
+{
+    m_offsets.emplace(key, m_keys.size());
+    m_keys.push_back(key);
+}
+
+Shape* Shape::addProperty(String* key)
+{
+    auto it = m_transitions.find(key);
+    if (it != m_transitions.end()) {
+        return it->second.get();
+    }
+    auto shape = std::unique_ptr<Shape>(new Shape(*this, key));
+    Shape* child = shape.get();
+    m_transitions.emplace(key, std::move(shape));
+    return child;
+}
+
+uint32_t Shape::offset(String* key) const
+{
+    auto it = m_offsets.find(key);
+    if (it == m_offsets.end()) {
+        return NotFound;
+    }
+    return it->second;
+}
+
+const std::vector<String*>& Shape::keys() const
+{
+    return m_keys;
+}
+
+size_t Shape::size() const
+{
+    return m_keys.size();
+}
+
+}
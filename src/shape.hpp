@@ -0,0 +1,33 @@
+#pragma once
+
+#include "forward.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace Msl {
+
+// Hidden class of an Object: maps each property key to a slot offset. Objects
+// that received the same keys in the same order share one shape. Adding a key
+// follows (or creates) a transition to the child shape that has it.
+class Shape {
+public:
+    static constexpr uint32_t NotFound = UINT32_MAX;
+
+    Shape();
+    Shape* addProperty(String* key);
+    uint32_t offset(String* key) const;
+    const std::vector<String*>& keys() const;
+    size_t size() const;
+
+private:
+    Shape(const Shape& parent, String* key);
+
+    std::vector<String*> m_keys;
+    std::unordered_map<String*, uint32_t> m_offsets;
+    std::unordered_map<String*, std::unique_ptr<Shape>> m_transitions;
+};
+
+}
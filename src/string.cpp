@@ -0,0 +1,65 @@
+#include "string.hpp"
+
+#include <cstdint>
+#include <functional>
+
+namespace Msl {
+
+String::String(std::string string, bool interned)
+    : m_string(std::move(string))
+    , m_hash(std::hash<std::string>()(m_string))
+    , m_interned(interned)
+{
+}
+
+const std::string& String::string() const
+{
+    return m_string;
+}
+
+size_t String::size() const
+{
+    return m_string.size();
+}
+
+size_t String::cellSize() const
+{
+    return sizeof(String);
+}
+
+size_t String::payloadSize() const
+{
+    // Short strings keep their text inside the cell.
+    auto data = reinterpret_cast<uintptr_t>(m_string.data());
+    auto cell = reinterpret_cast<uintptr_t>(this);
+    if (data >= cell && data < cell + sizeof(String)) {
+        return 0;
+    }
+    return m_string.capacity() + 1;
+}
+
+CellType String::cellType() const
+{
+    return CellType::String;
+}
+
+size_t String::hash() const
+{
+    return m_hash;
+}
+
+bool String::interned() const
+{
+    return m_interned;
+}
+
+bool String::equals(const String* other) const
+{
+    if (this == other)
+        return true;
+    if (m_interned && other->m_interned)
+        return false;
+    return m_hash == other->m_hash && m_string == other->m_string;
+}
+
+}
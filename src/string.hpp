@@ -0,0 +1,30 @@
+#pragma once
+
+#include "cell.hpp"
+
+#include <string>
+
+namespace Msl {
+
+// Immutable string contents of a string Value. The hash is computed once on
+// construction. Interned strings are unique per heap, two of them are equal
+// only if they are the same cell.
+class String final : public Cell {
+public:
+    explicit String(std::string string, bool interned = false);
+    const std::string& string() const;
+    size_t size() const;
+    size_t hash() const;
+    bool interned() const;
+    bool equals(const String* other) const;
+    virtual size_t cellSize() const override;
+    virtual size_t payloadSize() const override;
+    virtual CellType cellType() const override;
+
+private:
+    const std::string m_string;
+    const size_t m_hash;
+    const bool m_interned;
+};
+
+}
@@ -56,43 +56,30 @@ const std::unordered_map<Token::Type, std::string> Token::tokenTypeStrings = {
     { Token::Type::Eof, "Eof" },
 };
 
-Token::Token(Type type, const std::string& str, size_t line, size_t column)
-    : m_type(type)
-    , m_str(str)
-    , m_line(line)
-    , m_column(column)
+Token::Token()
+    : Token(Type::Eof, 0, 0, 0, 0)
+{
+}
+
+Token::Token(Type type, size_t offset, size_t length, size_t line, size_t column)
+    : m_offset(static_cast<uint32_t>(offset))
+    , m_length(static_cast<uint32_t>(length))
+    , m_line(static_cast<uint32_t>(line))
+    , m_column(static_cast<uint32_t>(column < MaxColumn ? column : MaxColumn))
+    , m_type(static_cast<uint32_t>(type))
 {
 }
 
 std::ostream& operator<<(std::ostream& os, const Token& token)
 {
     os << "[ "
-       << Token::tokenTypeStrings.at(token.m_type)
+       << Token::tokenTypeStrings.at(token.type())
        << " (" << token.m_line
        << ":" << token.m_column
-       << ") '" << token.m_str
-       << "' ]";
+       << ") @" << token.m_offset
+       << "+" << token.m_length
+       << " ]";
     return os;
 }
 
-Token::Type Token::type() const
-{
-    return m_type;
-}
-
-std::string Token::str() const
-{
-    return m_str;
-}
-
-size_t Token::line() const
-{
-    return m_line;
-}
-
-size_t Token::column() const
-{
-    return m_column;
-}
-
 }
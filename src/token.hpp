@@ -1,14 +1,19 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <ostream>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 namespace Msl {
 
+// A lexeme of the source: its type, where it starts and how long it is. The
+// text is not copied, it is read back from the source with lexeme().
 class Token {
 public:
-    enum class Type {
+    enum class Type : uint8_t {
         OpenParen,
         CloseParen,
         OpenBracket,
@@ -65,19 +70,29 @@ public:
     };
 
 public:
-    Token(Type type, const std::string& str, size_t line, size_t column);
+    // An Eof token at the start of the source.
+    Token();
+    Token(Type type, size_t offset, size_t length, size_t line, size_t column);
     friend std::ostream& operator<<(std::ostream& os, const Token& tok);
-    Type type() const;
-    std::string str() const;
-    size_t line() const;
-    size_t column() const;
+    Type type() const { return static_cast<Type>(m_type); }
+    size_t offset() const { return m_offset; }
+    size_t length() const { return m_length; }
+    size_t line() const { return m_line; }
+    size_t column() const { return m_column; }
+    std::string_view lexeme(std::string_view source) const { return source.substr(m_offset, m_length); }
 
 private:
+    static constexpr size_t MaxColumn = (1 << 24) - 1;
+
     static const std::unordered_map<Type, std::string> tokenTypeStrings;
 
-    Type m_type;
-    std::string m_str;
-    size_t m_line;
-    size_t m_column;
+    uint32_t m_offset { 0 };
+    uint32_t m_length { 0 };
+    uint32_t m_line { 0 };
+    // Columns past MaxColumn are clamped.
+    uint32_t m_column : 24;
+    uint32_t m_type : 8;
 };
+
+static_assert(sizeof(Token) == 16, "Tokens are kept in a flat vector, keep them small");
 }
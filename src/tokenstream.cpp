@@ -0,0 +1,26 @@
+#include "tokenstream.hpp"
+
+namespace Msl {
+
+TokenStream::TokenStream(Lexer& lexer)
+    : m_lexer(lexer)
+{
+}
+
+// Lexes up to the token i positions after the current one.
+void TokenStream::pull(size_t i)
+{
+    while (m_lexed <= m_current + i) {
+        if (m_current)
+            m_lexer.retain(previous().offset());
+        m_tokens[m_lexed % Capacity] = m_lexer.next();
+        m_lexed++;
+    }
+}
+
+std::string_view TokenStream::lexeme(const Token& token) const
+{
+    return m_lexer.lexeme(token);
+}
+
+}
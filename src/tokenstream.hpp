@@ -0,0 +1,57 @@
+#pragma once
+
+#include "lexer.hpp"
+#include "token.hpp"
+
+#include <cassert>
+#include <cstddef>
+#include <string_view>
+
+namespace Msl {
+
+// The parser's window on the lexer: tokens are pulled as the parser looks
+// ahead and kept in a ring buffer together with the previous token, whose
+// text is the oldest the lexer has to retain.
+class TokenStream {
+public:
+    static constexpr size_t MaxLookahead = 3;
+
+    explicit TokenStream(Lexer& lexer);
+
+    // The token i positions after the current one, i < MaxLookahead.
+    const Token& peek(size_t i)
+    {
+        assert(i < MaxLookahead);
+        if (m_current + i >= m_lexed)
+            pull(i);
+        return m_tokens[(m_current + i) % Capacity];
+    }
+
+    const Token& previous() const
+    {
+        assert(m_current);
+        return m_tokens[(m_current - 1) % Capacity];
+    }
+
+    void advance()
+    {
+        peek(0);
+        m_current++;
+    }
+
+    std::string_view lexeme(const Token& token) const;
+
+private:
+    static constexpr size_t Capacity = MaxLookahead + 1;
+
+    void pull(size_t i);
+
+    Lexer& m_lexer;
+    Token m_tokens[Capacity];
+    // Counted from the start of the input, the ring slot is the count
+    // modulo Capacity.
+    size_t m_current { 0 };
+    size_t m_lexed { 0 };
+};
+
+}
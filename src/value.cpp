@@ -1,7 +1,11 @@
 #include "value.hpp"
 
 #include "array.hpp"
+#include "function.hpp"
+#include "handle.hpp"
+#include "heap.hpp"
 #include "object.hpp"
+#include "string.hpp"
 
 #include <cassert>
 #include <cmath>
@@ -10,155 +14,39 @@
 
 namespace Msl {
 
-Value::Value()
-    : m_type(Type::Null)
+Cell* Value::cell() const
 {
-}
-
-Value::Value(bool boolean)
-    : m_type(Type::Boolean)
-    , m_value(boolean)
-{
-}
-
-Value::Value(double number)
-    : m_type(Type::Number)
-    , m_value(number)
-{
-}
-
-Value::Value(int32_t number)
-    : m_type(Type::Number)
-    , m_value(static_cast<double>(number))
-{
-}
-
-Value::Value(const std::string& string)
-    : m_type(Type::String)
-    , m_value(string)
-{
-}
-
-Value::Value(const char* string)
-    : m_type(Type::String)
-    , m_value(string)
-{
-}
-
-Value::Value(Function* function)
-    : m_type(Type::Function)
-    , m_value(function)
-{
-}
-
-Value::Value(Object* object)
-    : m_type(Type::Object)
-    , m_value(object)
-{
-}
-
-Value::Value(Array* array)
-    : m_type(Type::Array)
-    , m_value(array)
-{
-}
-
-bool Value::isNull() const
-{
-    return m_type == Type::Null;
-}
-
-bool Value::isBoolean() const
-{
-    return m_type == Type::Boolean;
-}
-
-bool Value::isNumber() const
-{
-    return m_type == Type::Number;
-}
-
-bool Value::isString() const
-{
-    return m_type == Type::String;
-}
-
-bool Value::isFunction() const
-{
-    return m_type == Type::Function;
-}
-
-bool Value::isObject() const
-{
-    return m_type == Type::Object;
-}
-
-bool Value::isArray() const
-{
-    return m_type == Type::Array;
-}
-
-bool Value::boolean() const
-{
-    assert(isBoolean());
-
-    return std::get<bool>(m_value);
-}
-
-double Value::number() const
-{
-    assert(isNumber());
-
-    return std::get<double>(m_value);
-}
-
-std::string Value::string() const
-{
-    assert(isString());
-
-    return std::get<std::string>(m_value);
-}
-
-Function* Value::function()
-{
-    assert(isFunction());
-    return std::get<Function*>(m_value);
-}
-
-Object* Value::object()
-{
-    assert(isObject());
-    return std::get<Object*>(m_value);
-}
-
-Array* Value::array()
-{
-    assert(isArray());
-    return std::get<Array*>(m_value);
-}
-
-Value::Type Value::type() const
-{
-    return m_type;
+    switch (type()) {
+    case Type::String:
+        return string();
+    case Type::Function:
+        return function();
+    case Type::Object:
+        return object();
+    case Type::Array:
+        return array();
+    default:
+        return nullptr;
+    }
 }
 
 bool Value::toBoolean() const
 {
-    switch (m_type) {
+    switch (type()) {
     case Type::Null:
         return false;
     case Type::Boolean:
-        return std::get<bool>(m_value);
+        return boolean();
     case Type::Number:
-        return std::get<double>(m_value) ? true : false;
+        return number() ? true : false;
     case Type::String:
-        return std::get<std::string>(m_value).size() ? true : false;
+        return string()->size() ? true : false;
     case Type::Object:
-        return std::get<Object*>(m_value)->isEmpty();
+        return !object()->isEmpty();
     case Type::Function:
         return true;
     case Type::Array:
-        return std::get<Array*>(m_value)->size() ? true : false;
+        return array()->size() ? true : false;
     }
 
     assert(false);
@@ -166,17 +54,17 @@ bool Value::toBoolean() const
 
 double Value::toNumber() const
 {
-    switch (m_type) {
+    switch (type()) {
     case Type::Null:
         return 0;
     case Type::Boolean:
-        return std::get<bool>(m_value) ? 1 : 0;
+        return boolean() ? 1 : 0;
     case Type::Number:
-        return std::get<double>(m_value);
+        return number();
     case Type::String:
         double ret;
         try {
-            ret = std::stod(std::get<std::string>(m_value));
+            ret = std::stod(string()->string());
         } catch (...) {
             ret = std::numeric_limits<double>::quiet_NaN();
         }
@@ -194,26 +82,27 @@ double Value::toNumber() const
 
 std::string Value::toString() const
 {
-    switch (m_type) {
+    switch (type()) {
     case Type::Null:
         return "null";
     case Type::Boolean:
-        return std::get<bool>(m_value) ? "true" : "false";
+        return boolean() ? "true" : "false";
     case Type::Number:
-        return std::to_string(std::get<double>(m_value));
+        return std::to_string(number());
     case Type::String:
-        return std::get<std::string>(m_value);
+        return string()->string();
     case Type::Function:
         return "Function";
     case Type::Object: {
         std::ostringstream ss;
         ss << '{';
-        const auto& m = std::get<Object*>(m_value)->properties();
-        for (auto it = m.begin(); it != m.end(); it++) {
-            ss << it->first;
+        Object* object = this->object();
+        const auto& keys = object->shape()->keys();
+        for (size_t i = 0; i < keys.size(); i++) {
+            ss << keys[i]->string();
             ss << ": ";
-            ss << it->second;
-            if (std::next(it) != m.end()) {
+            ss << object->slot(i);
+            if (i != keys.size() - 1) {
                 ss << ", ";
             }
         }
@@ -223,7 +112,7 @@ std::string Value::toString() const
     case Type::Array: {
         std::ostringstream ss;
         ss << '[';
-        const auto& array = std::get<Array*>(m_value);
+        Array* array = this->array();
         for (size_t i = 0; i < array->size(); i++) {
             ss << array->at(i);
             if (i != array->size() - 1) {
@@ -244,10 +133,23 @@ std::ostream& operator<<(std::ostream& os, const Value& value)
     return os;
 }
 
-Value Value::operator+(const Value& right)
+Value Value::add(Heap& heap, const Value& right) const
 {
     if (isString() || right.isString()) {
-        return Value(toString() + right.toString());
+        // The limit is checked before the text is built, a string doubling
+        // in a loop would otherwise run out of memory in the concatenation.
+        HandleScope scope(heap);
+        Handle rootedLeft(heap, *this);
+        Handle rootedRight(heap, right);
+        std::string leftText = isString() ? std::string() : toString();
+        std::string rightText = right.isString() ? std::string() : right.toString();
+        const std::string& leftString = isString() ? string()->string() : leftText;
+        const std::string& rightString = right.isString() ? right.string()->string() : rightText;
+        heap.reservePayload(leftString.size() + rightString.size() + 1);
+        std::string text;
+        text.reserve(leftString.size() + rightString.size());
+        text.append(leftString).append(rightString);
+        return Value(heap.allocate<String>(std::move(text)));
     }
     return Value(toNumber() + right.toNumber());
 }
@@ -275,7 +177,7 @@ Value Value::operator%(const Value& right)
 Value Value::operator==(Value& right)
 {
     if (isString() && right.isString()) {
-        return Value(toString() != right.toString());
+        return Value(string()->equals(right.string()));
     }
     if (isObject() && right.isObject()) {
         return Value(object() == right.object());
@@ -286,7 +188,7 @@ Value Value::operator==(Value& right)
 Value Value::operator!=(Value& right)
 {
     if (isString() && right.isString()) {
-        return Value(toString() == right.toString());
+        return Value(!string()->equals(right.string()));
     }
     if (isObject() && right.isObject()) {
         return Value(object() != right.object());
@@ -297,7 +199,7 @@ Value Value::operator!=(Value& right)
 Value Value::operator>(const Value& right)
 {
     if (isString() && right.isString()) {
-        return Value(toString() > right.toString());
+        return Value(string()->string() > right.string()->string());
     }
     return Value(toNumber() > right.toNumber());
 }
@@ -305,7 +207,7 @@ Value Value::operator>(const Value& right)
 Value Value::operator<(const Value& right)
 {
     if (isString() && right.isString()) {
-        return Value(toString() < right.toString());
+        return Value(string()->string() < right.string()->string());
     }
     return Value(toNumber() < right.toNumber());
 }
@@ -313,7 +215,7 @@ Value Value::operator<(const Value& right)
 Value Value::operator>=(const Value& right)
 {
     if (isString() && right.isString()) {
-        return Value(toString() >= right.toString());
+        return Value(string()->string() >= right.string()->string());
     }
     return Value(toNumber() >= right.toNumber());
 }
@@ -321,7 +223,7 @@ Value Value::operator>=(const Value& right)
 Value Value::operator<=(const Value& right)
 {
     if (isString() && right.isString()) {
-        return Value(toString() <= right.toString());
+        return Value(string()->string() <= right.string()->string());
     }
     return Value(toNumber() <= right.toNumber());
 }
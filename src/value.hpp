@@ -2,11 +2,19 @@
 
 #include "forward.hpp"
 
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
 #include <string>
-#include <variant>
 
 namespace Msl {
 
+// A NaN-boxed value. Numbers are stored as plain doubles (every NaN is
+// canonicalized to a positive quiet NaN), all other types are encoded in
+// negative quiet NaNs: the type sits in bits 48-50 and the payload, a boolean
+// or a cell pointer, in the low 48 bits.
 class Value
 {
 public:
@@ -20,38 +28,124 @@ public:
         Array
     };
 
-    Value();
-    Value(bool boolean);
-    Value(double number);
-    Value(int32_t number);
-    Value(const std::string& string);
-    Value(const char* string);
-    Value(Function* function);
-    Value(Object* object);
-    Value(Array* array);
-
-    bool isNull() const;
-    bool isBoolean() const;
-    bool isNumber() const;
-    bool isString() const;
-    bool isFunction() const;
-    bool isObject() const;
-    bool isArray() const;
-
-    bool boolean() const;
-    double number() const;
-    std::string string() const;
-    Function* function();
-    Object* object();
-    Array* array();
-    Type type() const;
+    Value()
+        : m_bits(box(Type::Null, 0u))
+    {
+    }
+
+    Value(bool boolean)
+        : m_bits(box(Type::Boolean, boolean))
+    {
+    }
+
+    Value(double number)
+    {
+        if (std::isnan(number)) {
+            m_bits = CanonicalNaN;
+        } else {
+            std::memcpy(&m_bits, &number, sizeof(number));
+        }
+    }
+
+    Value(int32_t number)
+        : Value(static_cast<double>(number))
+    {
+    }
+
+    Value(String* string)
+        : m_bits(boxCell(Type::String, string))
+    {
+    }
+
+    Value(Function* function)
+        : m_bits(boxCell(Type::Function, function))
+    {
+    }
+
+    Value(Object* object)
+        : m_bits(boxCell(Type::Object, object))
+    {
+    }
+
+    Value(Array* array)
+        : m_bits(boxCell(Type::Array, array))
+    {
+    }
+
+    // Strings are heap cells, build them with Heap::allocate<String>.
+    Value(const char* string) = delete;
+
+    // Held by the slot of a hoisted variable until its declaration runs.
+    static Value uninitialized()
+    {
+        Value value;
+        value.m_bits = box(Type::Null, 1);
+        return value;
+    }
+
+    bool isNull() const { return is(Type::Null); }
+    bool isBoolean() const { return is(Type::Boolean); }
+    bool isNumber() const { return (m_bits & BoxMask) != BoxMask; }
+    bool isString() const { return is(Type::String); }
+    bool isFunction() const { return is(Type::Function); }
+    bool isObject() const { return is(Type::Object); }
+    bool isArray() const { return is(Type::Array); }
+    bool isUninitialized() const { return m_bits == box(Type::Null, 1); }
+    bool isCell() const { return !isNumber() && (m_bits >> TypeShift) >= tag(Type::String); }
+
+    bool boolean() const
+    {
+        assert(isBoolean());
+        return m_bits & PayloadMask;
+    }
+
+    double number() const
+    {
+        assert(isNumber());
+        double number;
+        std::memcpy(&number, &m_bits, sizeof(number));
+        return number;
+    }
+
+    String* string() const
+    {
+        assert(isString());
+        return payload<String>();
+    }
+
+    Function* function() const
+    {
+        assert(isFunction());
+        return payload<Function>();
+    }
+
+    Object* object() const
+    {
+        assert(isObject());
+        return payload<Object>();
+    }
+
+    Array* array() const
+    {
+        assert(isArray());
+        return payload<Array>();
+    }
+
+    Type type() const
+    {
+        if (isNumber())
+            return Type::Number;
+        return static_cast<Type>((m_bits >> TypeShift) & TypeMask);
+    }
+
+    Cell* cell() const;
 
     bool toBoolean() const;
     double toNumber() const;
     std::string toString() const;
 
     friend std::ostream& operator<<(std::ostream& os, const Value& value);
-    Value operator+(const Value& right);
+    Value add(Heap& heap, const Value& right) const;
     Value operator-(const Value& right);
     Value operator*(const Value& right);
     Value operator/(const Value& right);
@@ -64,8 +158,43 @@ public:
     Value operator<=(const Value& right);
 
 private:
-    Type m_type { Type::Null };
-    std::variant<bool, double, std::string, Function*, Object*, Array*> m_value;
+    static constexpr uint64_t BoxMask = 0xfff8000000000000;
+    static constexpr uint64_t CanonicalNaN = 0x7ff8000000000000;
+    static constexpr uint64_t PayloadMask = 0x0000ffffffffffff;
+    static constexpr uint64_t TypeMask = 0x7;
+    static constexpr int TypeShift = 48;
+
+    static constexpr uint64_t tag(Type type)
+    {
+        return (BoxMask >> TypeShift) | static_cast<uint64_t>(type);
+    }
+
+    static uint64_t box(Type type, uint64_t payload)
+    {
+        return (tag(type) << TypeShift) | payload;
+    }
+
+    static uint64_t boxCell(Type type, const void* pointer)
+    {
+        uint64_t payload = reinterpret_cast<uintptr_t>(pointer);
+        assert(!(payload & ~PayloadMask));
+        return box(type, payload);
+    }
+
+    bool is(Type type) const
+    {
+        return (m_bits >> TypeShift) == tag(type);
+    }
+
+    template <typename T>
+    T* payload() const
+    {
+        return reinterpret_cast<T*>(static_cast<uintptr_t>(m_bits & PayloadMask));
+    }
+
+    uint64_t m_bits;
 };
 
+static_assert(sizeof(Value) == 8, "Value must stay a single machine word");
+
 }
@@ -0,0 +1,433 @@
+#include "vm.hpp"
+#include "array.hpp"
+#include "environment.hpp"
+#include "exceptions.hpp"
+#include "function.hpp"
+#include "interpreter.hpp"
+#include "string.hpp"
+
+#include <cassert>
+#include <iostream>
+
+namespace Msl {
+
+static Value applyAssignment(Heap& heap, uint8_t op, Value old, Value value)
+{
+    switch (static_cast<AssignmentExpression::Operator>(op)) {
+    case AssignmentExpression::Operator::Equals:
+        return value;
+    case AssignmentExpression::Operator::PlusEquals:
+        return old.add(heap, value);
+    case AssignmentExpression::Operator::MinusEquals:
+        return old - value;
+    case AssignmentExpression::Operator::AsteriskEquals:
+        return old * value;
+    case AssignmentExpression::Operator::SlashEquals:
+        return old / value;
+    case AssignmentExpression::Operator::ModuloEquals:
+        return old % value;
+    }
+    assert(false);
+    return value;
+}
+
+static Value applyUpdate(uint8_t flags, Value old)
+{
+    if (!old.isNumber())
+        throw RuntimeException("Can't incremenet/decrement non numbre variables");
+    return (flags & UpdateIncrement) ? old.number() + 1 : old.number() - 1;
+}
+
+static size_t arrayIndex(Value index)
+{
+    if (!index.isNumber())
+        throw RuntimeException("Can't use non number index on array");
+    return index.number();
+}
+
+VM::VM(Interpreter& interpreter)
+    : m_interpreter(interpreter)
+{
+}
+
+Value VM::run(const Chunk& chunk)
+{
+    m_frames.push_back({ &chunk, chunk.code().data(), m_interpreter.stack().size() });
+    try {
+        return execute();
+    } catch (...) {
+        m_stack.clear();
+        m_frames.clear();
+        throw;
+    }
+}
+
+const std::vector<Value>& VM::stack() const
+{
+    return m_stack;
+}
+
+std::vector<Value>& VM::stack()
+{
+    return m_stack;
+}
+
+Value VM::pop()
+{
+    Value value = m_stack.back();
+    m_stack.pop_back();
+    return value;
+}
+
+Value VM::execute()
+{
+    Stack& scopes = m_interpreter.stack();
+    Heap& heap = m_interpreter.heap();
+    Frame* frame = &m_frames.back();
+    const Chunk* chunk = frame->chunk;
+    const uint8_t* ip = frame->ip;
+
+    auto readByte = [&]() {
+        return *ip++;
+    };
+    auto readShort = [&]() {
+        uint16_t value = ip[0] | (ip[1] << 8);
+        ip += 2;
+        return value;
+    };
+    auto readKey = [&]() {
+        return chunk->constants()[readShort()].string();
+    };
+    auto readCache = [&]() -> InlineCache& {
+        return *chunk->inlineCaches()[readShort()];
+    };
+    auto readEnvironment = [&]() {
+        Environment* environment = scopes.back();
+        for (uint8_t depth = readByte(); depth; --depth) {
+            environment = environment->parent();
+        }
+        return environment;
+    };
+
+    for (;;) {
+        switch (static_cast<OpCode>(readByte())) {
+        case OpCode::Constant:
+            m_stack.push_back(chunk->constants()[readShort()]);
+            break;
+        case OpCode::Null:
+            m_stack.push_back(Value());
+            break;
+        case OpCode::True:
+            m_stack.push_back(Value(true));
+            break;
+        case OpCode::False:
+            m_stack.push_back(Value(false));
+            break;
+        case OpCode::Pop:
+            m_stack.pop_back();
+            break;
+
+        case OpCode::Add: {
+            Value right = pop();
+            m_stack.back() = m_stack.back().add(heap, right);
+            break;
+        }
+        case OpCode::Subtract: {
+            Value right = pop();
+            m_stack.back() = m_stack.back() - right;
+            break;
+        }
+        case OpCode::Multiply: {
+            Value right = pop();
+            m_stack.back() = m_stack.back() * right;
+            break;
+        }
+        case OpCode::Divide: {
+            Value right = pop();
+            m_stack.back() = m_stack.back() / right;
+            break;
+        }
+        case OpCode::Modulo: {
+            Value right = pop();
+            m_stack.back() = m_stack.back() % right;
+            break;
+        }
+        case OpCode::Equal: {
+            Value right = pop();
+            m_stack.back() = m_stack.back() == right;
+            break;
+        }
+        case OpCode::NotEqual: {
+            Value right = pop();
+            m_stack.back() = m_stack.back() != right;
+            break;
+        }
+        case OpCode::Greater: {
+            Value right = pop();
+            m_stack.back() = m_stack.back() > right;
+            break;
+        }
+        case OpCode::Less: {
+            Value right = pop();
+            m_stack.back() = m_stack.back() < right;
+            break;
+        }
+        case OpCode::GreaterEqual: {
+            Value right = pop();
+            m_stack.back() = m_stack.back() >= right;
+            break;
+        }
+        case OpCode::LessEqual: {
+            Value right = pop();
+            m_stack.back() = m_stack.back() <= right;
+            break;
+        }
+        case OpCode::Not:
+            m_stack.back() = Value(!m_stack.back().toBoolean());
+            break;
+        case OpCode::Negate:
+            m_stack.back() = Value(-m_stack.back().toNumber());
+            break;
+        case OpCode::Plus:
+            m_stack.back() = Value(m_stack.back().toNumber());
+            break;
+
+        case OpCode::GetVariable: {
+            Environment* environment = readEnvironment();
+            m_stack.push_back(environment->get(readShort()));
+            break;
+        }
+        case OpCode::DeclareVariable: {
+            Environment* environment = readEnvironment();
+            environment->set(readShort(), pop());
+            break;
+        }
+        case OpCode::Undefined:
+            throw RuntimeException("Variable is undefined");
+        case OpCode::AssignVariable: {
+            Environment* environment = readEnvironment();
+            uint16_t slot = readShort();
+            uint8_t op = readByte();
+            Value value = applyAssignment(heap, op, environment->get(slot), m_stack.back());
+            environment->set(slot, value);
+            m_stack.back() = value;
+            break;
+        }
+        case OpCode::UpdateVariable: {
+            Environment* environment = readEnvironment();
+            uint16_t slot = readShort();
+            uint8_t flags = readByte();
+            Value old = environment->get(slot);
+            Value updated = applyUpdate(flags, old);
+            environment->set(slot, updated);
+            m_stack.push_back((flags & UpdatePrefix) ? updated : old);
+            break;
+        }
+
+        case OpCode::GetProperty: {
+            String* name = readKey();
+            InlineCache& cache = readCache();
+            Value object = m_stack.back();
+            m_stack.back() = object.isObject() ? object.object()->get(name, cache) : Value();
+            break;
+        }
+        case OpCode::InitProperty: {
+            uint16_t offset = readShort();
+            Value value = pop();
+            m_stack.back().object()->slot(offset, value);
+            break;
+        }
+        case OpCode::AssignProperty: {
+            String* name = readKey();
+            InlineCache& cache = readCache();
+            uint8_t op = readByte();
+            Value object = m_stack.back();
+            if (!object.isObject())
+                throw RuntimeException("Assignment left expresion is not an object");
+            Object* obj = object.object();
+            Value value = m_stack.end()[-2];
+            // A plain store doesn't need the old value, only compound ones
+            // look the property up first.
+            if (op != static_cast<uint8_t>(AssignmentExpression::Operator::Equals))
+                value = applyAssignment(heap, op, obj->get(name, cache), value);
+            m_stack.pop_back();
+            m_stack.back() = obj->set(name, value, cache);
+            break;
+        }
+        case OpCode::UpdateProperty: {
+            String* name = readKey();
+            InlineCache& cache = readCache();
+            uint8_t flags = readByte();
+            Value object = m_stack.back();
+            Value old = object.isObject() ? object.object()->get(name, cache) : Value();
+            Value updated = applyUpdate(flags, old);
+            object.object()->set(name, updated, cache);
+            m_stack.back() = (flags & UpdatePrefix) ? updated : old;
+            break;
+        }
+
+        case OpCode::GetElement: {
+            Value index = pop();
+            Value array = m_stack.back();
+            if (!array.isArray())
+                throw RuntimeException("ArrayMemeberExpression on a non array value");
+            m_stack.back() = array.array()->at(arrayIndex(index));
+            break;
+        }
+        case OpCode::AssignElement: {
+            uint8_t op = readByte();
+            Value index = m_stack.back();
+            Value array = m_stack.end()[-2];
+            if (!array.isArray())
+                throw RuntimeException("Assignment left expression is not an array");
+            if (!index.isNumber())
+                throw RuntimeException("Can't use non number to access array element");
+            Array* arr = array.array();
+            size_t i = index.number();
+            Value value = applyAssignment(heap, op, arr->at(i), m_stack.end()[-3]);
+            m_stack.resize(m_stack.size() - 2);
+            m_stack.back() = arr->at(i, value);
+            break;
+        }
+        case OpCode::UpdateElement: {
+            uint8_t flags = readByte();
+            Value index = pop();
+            Value array = m_stack.back();
+            if (!array.isArray())
+                throw RuntimeException("not an Array");
+            Array* arr = array.array();
+            size_t i = arrayIndex(index);
+            Value old = arr->at(i);
+            Value updated = applyUpdate(flags, old);
+            arr->at(i, updated);
+            m_stack.back() = (flags & UpdatePrefix) ? updated : old;
+            break;
+        }
+
+        case OpCode::NewObject:
+            m_stack.push_back(Value(heap.allocate<Object>(chunk->shapes()[readShort()])));
+            break;
+        case OpCode::NewArray: {
+            uint16_t count = readShort();
+            auto array = heap.allocate<Array>();
+            // New cells are black while the heap is marking, the elements
+            // have to go through the barrier.
+            for (auto it = m_stack.end() - count; it != m_stack.end(); ++it) {
+                array->append(*it);
+            }
+            m_stack.resize(m_stack.size() - count);
+            m_stack.push_back(Value(array));
+            break;
+        }
+        case OpCode::MakeFunction: {
+            const auto& prototype = chunk->functions()[readShort()];
+            auto function = heap.allocate<Function>(prototype.params(), prototype.slotCount(), scopes.back(), &prototype.chunk());
+            m_stack.push_back(Value(function));
+            break;
+        }
+
+        case OpCode::PushScope: {
+            uint16_t slotCount = readShort();
+            scopes.push_back(heap.allocate<Environment>(scopes.back(), slotCount));
+            break;
+        }
+        case OpCode::PopScope:
+            scopes.pop_back();
+            break;
+
+        case OpCode::Jump: {
+            uint16_t offset = readShort();
+            ip += offset;
+            break;
+        }
+        case OpCode::JumpIfFalse: {
+            uint16_t offset = readShort();
+            if (!pop().toBoolean())
+                ip += offset;
+            break;
+        }
+        case OpCode::JumpIfFalseOrPop: {
+            uint16_t offset = readShort();
+            if (!m_stack.back().toBoolean())
+                ip += offset;
+            else
+                m_stack.pop_back();
+            break;
+        }
+        case OpCode::JumpIfTrueOrPop: {
+            uint16_t offset = readShort();
+            if (m_stack.back().toBoolean())
+                ip += offset;
+            else
+                m_stack.pop_back();
+            break;
+        }
+        case OpCode::Loop: {
+            uint16_t offset = readShort();
+            ip -= offset;
+            // Every reference is on the stack or in a scope here.
+            heap.safepoint();
+            break;
+        }
+
+        case OpCode::Call: {
+            uint8_t argc = readByte();
+            Value callee = m_stack[m_stack.size() - argc - 1];
+            if (!callee.isFunction()) {
+                throw RuntimeException("Trying to call a non function value");
+            }
+            Function* function = callee.function();
+            if (!function->variadic() && function->paramCount() != argc) {
+                throw RuntimeException("Invalid number of parameters to function");
+            }
+
+            if (!function->chunk()) {
+                std::vector<Value> arguments(m_stack.end() - argc, m_stack.end());
+                Value ret = function->execute(m_interpreter, arguments);
+                m_stack.resize(m_stack.size() - argc);
+                m_stack.back() = ret;
+                break;
+            }
+
+            Environment* environment = function->closure();
+            if (function->slotCount()) {
+                environment = heap.allocate<Environment>(
+                    function->closure(), function->slotCount());
+                for (size_t i = 0; i < argc; ++i) {
+                    environment->set(i, m_stack[m_stack.size() - argc + i]);
+                }
+            }
+            m_stack.resize(m_stack.size() - argc - 1);
+
+            frame->ip = ip;
+            m_frames.push_back({ function->chunk(), function->chunk()->code().data(), scopes.size() });
+            scopes.push_back(environment);
+            frame = &m_frames.back();
+            chunk = frame->chunk;
+            ip = frame->ip;
+            // Loops written as recursion compact here.
+            heap.safepoint();
+            break;
+        }
+        case OpCode::Return: {
+            Value ret = pop();
+            scopes.resize(frame->scopeBase);
+            m_frames.pop_back();
+            if (m_frames.empty()) {
+                return ret;
+            }
+            frame = &m_frames.back();
+            chunk = frame->chunk;
+            ip = frame->ip;
+            m_stack.push_back(ret);
+            heap.safepoint();
+            break;
+        }
+        case OpCode::Print:
+            std::cout << pop() << std::endl;
+            break;
+        }
+    }
+}
+
+}
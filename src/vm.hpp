@@ -0,0 +1,33 @@
+#pragma once
+
+#include "chunk.hpp"
+#include "forward.hpp"
+#include "value.hpp"
+
+#include <vector>
+
+namespace Msl {
+
+class VM {
+public:
+    explicit VM(Interpreter& interpreter);
+    Value run(const Chunk& chunk);
+    const std::vector<Value>& stack() const;
+    std::vector<Value>& stack();
+
+private:
+    struct Frame {
+        const Chunk* chunk;
+        const uint8_t* ip;
+        size_t scopeBase;
+    };
+
+    Value execute();
+    Value pop();
+
+    Interpreter& m_interpreter;
+    std::vector<Value> m_stack;
+    std::vector<Frame> m_frames;
+};
+
+}